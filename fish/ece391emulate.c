@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "ece391support.h"
@@ -225,3 +226,37 @@ ece391_close (int32_t fd)
     return 0;
 }
 
+int32_t 
+ece391_fstat (int32_t fd, ece391_stat_t* buf)
+{
+    struct stat st;
+
+    if (0 != fstat (fd, &st))
+        return -1;
+    buf->type = (S_ISDIR (st.st_mode) ? 1 : 2);
+    buf->inode = st.st_ino;
+    buf->size = st.st_size;
+    buf->blocks = (st.st_size + 4095) / 4096;
+    return 0;
+}
+
+void* 
+ece391_mmap (int32_t fd, uint32_t length, int32_t prot)
+{
+    ece391_stat_t st;
+
+    if (-1 == fd)
+        return mmap ((void*)0, length, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (0 == length) {
+        if (0 != ece391_fstat (fd, &st))
+	    return (void*)-1;
+	length = st.size;
+    }
+    return mmap ((void*)0, length, prot, MAP_PRIVATE, fd, 0);
+}
+
+void*
+ece391_sbrk (int32_t increment)
+{
+    return sbrk (increment);
+}
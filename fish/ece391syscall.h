@@ -20,5 +20,33 @@ extern int32_t ece391_close (int32_t fd);
 extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 
+/* File information filled in by fstat. */
+typedef struct ece391_stat {
+	uint32_t type;
+	uint32_t inode;
+	uint32_t size;
+	uint32_t blocks;
+} __attribute__((packed)) ece391_stat_t;
+
+extern int32_t ece391_fstat (int32_t fd, ece391_stat_t* buf);
+
+/*
+ * mmap maps an open file read-only; with PROT_WRITE the mapping is
+ * private and pages are copied on their first write.  With fd -1 it
+ * maps length bytes of zeroed memory instead.  Returns (void*)-1 on
+ * failure.
+ */
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
+
+extern void* ece391_mmap (int32_t fd, uint32_t length, int32_t prot);
+
+/*
+ * sbrk moves the end of the heap (which starts right after the
+ * program) by increment bytes and returns the old end, or (void*)-1
+ * if it can't.  ece391_malloc in ece391support.c sits on top of it.
+ */
+extern void* ece391_sbrk (int32_t increment);
+
 #endif /* ECE391SYSCALL_H */
 
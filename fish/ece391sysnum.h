@@ -11,5 +11,8 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_FSTAT  13
+#define SYS_MMAP  16
+#define SYS_SBRK  18
 
 #endif /* ECE391SYSNUM_H */
@@ -18,15 +18,11 @@ uint8_t file1[] = "frame1.txt";
 extern int mp1_ioctl(unsigned long arg, unsigned long cmd);
 extern void mp1_rtc_tasklet(unsigned long trash);
 
-static struct mp1_blink_struct blink_array[80*25];
-
 int main(void)
 {
     int rtc_fd, ret_val, i, garbage;
     struct mp1_blink_struct blink_struct;
 
-    ece391_memset(blink_array, 0, sizeof(struct mp1_blink_struct)*80*25);
-
     if(mp1_set_video_mode() == NULL) {
         return -1;
     }
@@ -78,9 +74,11 @@ int main(void)
 void
 add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
 {
-    int32_t row, col, offset = 40, eof0 = 0, eof1 = 0, num_bytes;
-    int32_t fd0, fd1;
+    int32_t row, col, offset = 40, eof0 = 0, eof1 = 0;
+    int32_t fd0, fd1, pos0 = 0, pos1 = 0;
     struct mp1_blink_struct blink_struct;
+    ece391_stat_t st0, st1;
+    uint8_t *m0, *m1;
     uint8_t c0 = '0', c1 = '0';
 
     blink_struct.on_length = 15;
@@ -95,23 +93,36 @@ add_frames(uint8_t *f0, uint8_t *f1, int32_t rtc_fd)
         ece391_halt(-1);
     }
 
+    /* map both frames instead of reading them a byte at a time */
+    if( ece391_fstat(fd0, &st0) < 0 || ece391_fstat(fd1, &st1) < 0 ) {
+        ece391_halt(-1);
+    }
+    if( (m0 = ece391_mmap(fd0, 0, PROT_READ)) == (uint8_t*)-1 ) {
+        ece391_halt(-1);
+    }
+    if( (m1 = ece391_mmap(fd1, 0, PROT_READ)) == (uint8_t*)-1 ) {
+        ece391_halt(-1);
+    }
+
     while(eof0 == 0 || eof1 == 0) {
         col = 0;
         while(1) {
 
             if(c0 != '\n') {
-                num_bytes = ece391_read(fd0, &c0, 1);
-                if(num_bytes == 0) {
+                if(pos0 == st0.size) {
                     c0 = '\n';
                     eof0 = 1;
+                } else {
+                    c0 = m0[pos0++];
                 }
             }
 
             if(c1 != '\n') {
-                num_bytes = ece391_read(fd1, &c1, 1);
-                if(num_bytes == 0) {
+                if(pos1 == st1.size) {
                     c1 = '\n';
                     eof1 = 1;
+                } else {
+                    c1 = m1[pos1++];
                 }
             }
 
@@ -159,19 +170,12 @@ mp1_set_video_mode (void)
 
 void* mp1_malloc(int32_t size)
 {
-    int32_t i;
-    for(i=0; i< 80*25; i++) {
-        if(blink_array[i].location == 0) {
-            return &blink_array[i];
-        }
-    }
-
-    return NULL;
+    return ece391_malloc(size);
 }
 
 void mp1_free(void* memory)
 {
-    ece391_memset(memory, 0, sizeof(struct mp1_blink_struct));
+    ece391_free(memory);
 }
 
 void ece391_memset(void* memory, char c, int n)
@@ -0,0 +1,135 @@
+/* acpi.c - Finding the MADT among the firmware's ACPI tables
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#include "acpi.h"
+#include "lib.h"
+
+/* Externally visible variables */
+struct acpi_madt acpi_madt;
+
+
+/*
+ * acpi_sum
+ * DESCRIPTION: every ACPI table's bytes add up to 0
+ * INPUTS: p - table, len - its length
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if they do
+ * SIDE EFFECTS: none
+ */
+static uint32_t acpi_sum(const uint8_t* p, uint32_t len) {
+    uint8_t sum = 0;
+
+    while (len-- > 0)
+        sum += *p++;
+    return sum == 0;
+}
+
+/*
+ * acpi_rsdp_scan
+ * DESCRIPTION: looks for the RSDP signature on the 16-byte boundaries of
+ *              [start, end)
+ * INPUTS: start, end - physical addresses
+ * OUTPUTS: none
+ * RETURN VALUE: the RSDT's address, 0 if there is no valid RSDP
+ * SIDE EFFECTS: none
+ */
+static uint32_t acpi_rsdp_scan(uint32_t start, uint32_t end) {
+    uint8_t* p;
+
+    for (p = (uint8_t*)start; p < (uint8_t*)end; p += 16) {
+        if (strncmp((int8_t*)p, (int8_t*)"RSD PTR ", 8) == 0 && acpi_sum(p, ACPI_RSDP_LEN))
+            return *(uint32_t*)(p + 16);
+    }
+    return 0;
+}
+
+/*
+ * acpi_find
+ * DESCRIPTION: finds the table with signature sig through the RSDT
+ * INPUTS: sig - 4 characters
+ * OUTPUTS: none
+ * RETURN VALUE: the table, NULL if there is none
+ * SIDE EFFECTS: none
+ */
+static uint8_t* acpi_find(const char* sig) {
+    uint32_t ebda = *(uint16_t*)ACPI_EBDA_SEG << 4;
+    uint32_t rsdt, n, i;
+    uint8_t* t;
+
+    rsdt = acpi_rsdp_scan(ebda, ebda + ACPI_EBDA_LEN);
+    if (rsdt == 0)
+        rsdt = acpi_rsdp_scan(ACPI_BIOS_START, ACPI_BIOS_END);
+    if (rsdt == 0 || !acpi_sum((uint8_t*)rsdt, *(uint32_t*)(rsdt + 4)))
+        return NULL;
+
+    n = (*(uint32_t*)(rsdt + 4) - ACPI_HDR_LEN) / 4;
+    for (i = 0; i < n; i++) {
+        t = (uint8_t*)((uint32_t*)(rsdt + ACPI_HDR_LEN))[i];
+        if (strncmp((int8_t*)t, (int8_t*)sig, 4) == 0 && acpi_sum(t, *(uint32_t*)(t + 4)))
+            return t;
+    }
+    return NULL;
+}
+
+/*
+ * acpi_init
+ * DESCRIPTION: reads the processors, the IOAPIC and the ISA interrupt
+ *              overrides out of the MADT. The tables are wherever the
+ *              firmware left them in physical memory, so this runs before
+ *              page_init, while the kernel still addresses it directly.
+ *              ISA IRQs that aren't overridden keep their number as
+ *              IOAPIC input, unless an override gave that input to
+ *              another IRQ (IRQ0 usually takes input 2, and IRQ2, the
+ *              8259 cascade, has none then).
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if there is a MADT, -1 if not
+ * SIDE EFFECTS: fills in acpi_madt
+ */
+int32_t acpi_init(void) {
+    uint8_t* madt = acpi_find("APIC");
+    uint8_t* e;
+    uint8_t* end;
+    uint32_t i, j, overridden = 0;
+
+    memset(&acpi_madt, 0, sizeof(acpi_madt));
+    if (madt == NULL)
+        return -1;
+    acpi_madt.found = 1;
+    acpi_madt.pic = *(uint32_t*)(madt + 40) & MADT_PCAT_COMPAT;
+    for (i = 0; i < ISA_IRQS; i++)
+        acpi_madt.isa_gsi[i] = i;
+
+    end = madt + *(uint32_t*)(madt + 4);
+    for (e = madt + MADT_ENTRIES; e + 2 <= end && e[1] >= 2; e += e[1]) {
+        switch (e[0]) {
+        case MADT_LAPIC:
+            if ((*(uint32_t*)(e + 4) & MADT_LAPIC_ENABLED) && acpi_madt.ncpus < MAX_CPUS)
+                acpi_madt.cpu_apic[acpi_madt.ncpus++] = e[3];
+            break;
+        case MADT_IOAPIC:
+            if (*(uint32_t*)(e + 8) == 0) {    /* the one whose inputs start at 0 */
+                acpi_madt.ioapic_id = e[2];
+                acpi_madt.ioapic_base = *(uint32_t*)(e + 4);
+            }
+            break;
+        case MADT_OVERRIDE:
+            if (e[2] == 0 && e[3] < ISA_IRQS) { /* bus 0 is ISA */
+                acpi_madt.isa_gsi[e[3]] = *(uint32_t*)(e + 4);
+                acpi_madt.isa_flags[e[3]] = *(uint16_t*)(e + 8);
+                overridden |= 1 << e[3];
+            }
+            break;
+        }
+    }
+
+    for (i = 0; i < ISA_IRQS; i++) {
+        for (j = 0; j < ISA_IRQS; j++) {
+            if ((overridden & (1 << j)) && j != i && !(overridden & (1 << i)) &&
+                    acpi_madt.isa_gsi[j] == i)
+                acpi_madt.isa_gsi[i] = ISA_GSI_NONE;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+/* acpi.h - What the firmware's ACPI tables tell about interrupts and processors
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _ACPI_H
+#define _ACPI_H
+
+#include "types.h"
+#include "x86_desc.h"
+
+/* The RSDP is in the first KiB of the EBDA, whose segment the BIOS data
+ * area holds, or in the BIOS ROM */
+#define ACPI_EBDA_SEG		0x40E
+#define ACPI_EBDA_LEN		0x400
+#define ACPI_BIOS_START		0xE0000
+#define ACPI_BIOS_END		0x100000
+#define ACPI_RSDP_LEN		20		/* the ACPI 1.0 part the checksum covers */
+#define ACPI_HDR_LEN		36		/* of every system description table */
+
+/* MADT entries */
+#define MADT_ENTRIES		44		/* offset of the first one */
+#define MADT_PCAT_COMPAT	0x1		/* flags: there are 8259s too */
+#define MADT_LAPIC			0
+#define MADT_IOAPIC			1
+#define MADT_OVERRIDE		2
+#define MADT_LAPIC_ENABLED	0x1
+
+/* MPS INTI flags of an interrupt source override */
+#define MPS_POLARITY		0x3
+#define MPS_ACTIVE_LOW		0x3
+#define MPS_TRIGGER			0xC
+#define MPS_LEVEL			0xC
+
+#define ISA_IRQS			16
+#define ISA_GSI_NONE		0xFFFFFFFF	/* IRQ with no IOAPIC input of its own */
+
+/* What acpi_init found in the MADT */
+struct acpi_madt {
+	uint32_t found;					/* 1 if there is a MADT, the rest is 0 if not */
+	uint32_t pic;					/* 1 if the 8259s are there as well */
+	uint32_t ncpus;					/* usable processors, at most MAX_CPUS */
+	uint32_t cpu_apic[MAX_CPUS];	/* ...their local APIC IDs */
+	uint32_t ioapic_base;			/* the IOAPIC with the ISA interrupts, 0 for none */
+	uint32_t ioapic_id;
+	uint32_t isa_gsi[ISA_IRQS];		/* IOAPIC input of each ISA IRQ, or ISA_GSI_NONE */
+	uint32_t isa_flags[ISA_IRQS];	/* ...and its MPS INTI flags, 0 for ISA's rising edge */
+};
+
+/* Externally-visible variables */
+extern struct acpi_madt acpi_madt;
+
+/* Externally-visible functions */
+
+/* finds the MADT and fills in acpi_madt; before page_init. 0 if found */
+int32_t acpi_init(void);
+
+#endif /* _ACPI_H */
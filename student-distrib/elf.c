@@ -0,0 +1,363 @@
+/* elf.c - Loads ELF executables into user pages
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#include "elf.h"
+#include "lib.h"
+#include "filesystem.h"
+#include "paging.h"
+#include "stats.h"
+#include "scheduling.h"
+
+/* Local variables */
+static const int8_t elf_magic[4] = {0x7f, 0x45, 0x4c, 0x46};	// first 4 bytes identifying an executable
+static struct exec_image exec_cache[EXEC_SLOTS];	// prepared executables
+static uint32_t exec_launch;	// launches so far, stamps exec_image.last
+
+/*
+ * elf_check
+ * DESCRIPTION: reads the ELF header of a file and checks that it is a
+ *              32-bit x86 executable
+ * INPUTS: inode of the file, header to fill in
+ * OUTPUTS: 0 if it is an executable, -1 if not
+ */
+int32_t elf_check(uint32_t nd, struct elf_header* eh)
+{
+	if(read_data(nd, 0, (uint8_t*)eh, sizeof(struct elf_header)) != sizeof(struct elf_header))
+		return -1;
+	if(strncmp((int8_t*)eh->ident, elf_magic, 4))	//4 bytes of magic
+		return -1;
+	if(eh->type != ET_EXEC || eh->machine != EM_386 || eh->phentsize != sizeof(struct elf_phdr))
+		return -1;
+	return 0;
+}
+
+/*
+ * elf_segment
+ * DESCRIPTION: reads program header i and checks that the segment fits
+ *              below the stack in the program page
+ * INPUTS: inode, ELF header, index, program header to fill in
+ * OUTPUTS: 1 for a segment to load, 0 for one to skip, -1 if it is bad
+ */
+static int32_t elf_segment(uint32_t nd, struct elf_header* eh, uint32_t i, struct elf_phdr* ph)
+{
+	uint32_t limit = USER_STACK;
+
+	if(read_data(nd, eh->phoff + i * sizeof(*ph), (uint8_t*)ph, sizeof(*ph)) != sizeof(*ph))
+		return -1;
+	if(ph->type != PT_LOAD || ph->memsz == 0)
+		return 0;
+	if(ph->vaddr < USER_START || ph->vaddr >= limit || ph->memsz > limit - ph->vaddr
+		|| ph->filesz > ph->memsz)
+		return -1;
+	return 1;
+}
+
+/*
+ * elf_load_direct
+ * DESCRIPTION: maps every PT_LOAD segment of an executable at its virtual
+ *              address in the user pages of pid. Pages holding file data are
+ *              filled now; pages that are only bss are reserved and zeroed
+ *              on first touch, so only what a segment needs takes memory.
+ *              Used for executables too big for the image cache.
+ * INPUTS: inode of the executable, pid, where to put the entry point and
+ *         the first page after the image
+ * OUTPUTS: 0 on success, -1 if the file is not a loadable executable or we
+ *          ran out of frames (the caller releases what was mapped)
+ */
+static int32_t elf_load_direct(uint32_t nd, uint32_t pid, uint32_t* entry, uint32_t* image_end)
+{
+	struct elf_header eh;
+	struct elf_phdr ph;
+	uint32_t i, va, from, to, frame, fend, end, rw;
+	int32_t ret;
+
+	if(elf_check(nd, &eh))
+		return -1;
+
+	*image_end = USER_START;
+	for(i = 0; i < eh.phnum; i++)
+	{
+		if((ret = elf_segment(nd, &eh, i, &ph)) <= 0)
+		{
+			if(ret < 0)
+				return -1;
+			continue;
+		}
+
+		rw = (ph.flags & PF_W) ? 1 : 0;
+		fend = ph.vaddr + ph.filesz;
+		end = ph.vaddr + ph.memsz;
+		for(va = ph.vaddr & ~(FRAME_SIZE - 1); va < end; va += FRAME_SIZE)
+		{
+			if(va >= fend)
+			{	//only bss left on this page
+				map_user_zero(pid, va, rw);
+				continue;
+			}
+			if((frame = map_user_frame(pid, va, rw)) == 0)
+				return -1;
+			from = (va > ph.vaddr) ? va : ph.vaddr;
+			to = (va + FRAME_SIZE < fend) ? va + FRAME_SIZE : fend;
+			read_data(nd, ph.offset + (from - ph.vaddr), (uint8_t*)(frame + (from - va)), to - from);
+		}
+		if(va > *image_end)
+			*image_end = va;
+	}
+
+	*entry = eh.entry;
+	return 0;
+}
+
+/*
+ * exec_drop
+ * DESCRIPTION: gives the frames of a cached image back and frees its slot
+ * INPUTS: the image
+ * OUTPUTS: none
+ */
+static void exec_drop(struct exec_image* img)
+{
+	uint32_t i;
+	for(i = 0; i < img->npages; i++)
+		free_frame(img->pages[i].frame);
+	img->npages = 0;
+	img->nzeros = 0;
+	img->used = 0;
+}
+
+/*
+ * exec_page_get
+ * DESCRIPTION: finds the prepared page at va, adding a zeroed one if there
+ *              is none yet (two segments can share a page)
+ * INPUTS: the image being built, user address of the page
+ * OUTPUTS: the page, NULL if the image is full or we ran out of frames
+ */
+static struct exec_page* exec_page_get(struct exec_image* img, uint32_t va)
+{
+	uint32_t i, frame;
+	for(i = 0; i < img->npages; i++)
+	{
+		if(img->pages[i].va == va)
+			return &img->pages[i];
+	}
+	if(img->npages == EXEC_PAGES || (frame = alloc_zeroed_frame()) == 0)
+		return NULL;
+	img->pages[i].va = va;
+	img->pages[i].frame = frame;
+	img->pages[i].rw = 0;
+	img->npages++;
+	return &img->pages[i];
+}
+
+/*
+ * exec_build
+ * DESCRIPTION: reads an executable once into a cache slot: the file part of
+ *              every segment goes into prepared pages, the pages that are only
+ *              bss are remembered as ranges
+ * INPUTS: empty (pinned) slot, inode of the executable
+ * OUTPUTS: 0 on success, -1 if the file is not a loadable executable or does
+ *          not fit in a slot; the slot is left empty then
+ */
+static int32_t exec_build(struct exec_image* img, uint32_t nd)
+{
+	struct elf_header eh;
+	struct elf_phdr ph;
+	struct exec_page* pg;
+	uint32_t i, j, va, from, to, fend, end, rw;
+	int32_t ret;
+
+	img->inode = nd;
+	img->end = USER_START;
+	img->npages = 0;
+	img->nzeros = 0;
+	img->used = 1;
+	if(elf_check(nd, &eh))
+		goto fail;
+
+	for(i = 0; i < eh.phnum; i++)
+	{
+		if((ret = elf_segment(nd, &eh, i, &ph)) <= 0)
+		{
+			if(ret < 0)
+				goto fail;
+			continue;
+		}
+
+		rw = (ph.flags & PF_W) ? 1 : 0;
+		fend = ph.vaddr + ph.filesz;
+		end = ph.vaddr + ph.memsz;
+		for(va = ph.vaddr & ~(FRAME_SIZE - 1); va < end && va < fend; va += FRAME_SIZE)
+		{
+			if((pg = exec_page_get(img, va)) == NULL)
+				goto fail;
+			pg->rw |= rw;
+			from = (va > ph.vaddr) ? va : ph.vaddr;
+			to = (va + FRAME_SIZE < fend) ? va + FRAME_SIZE : fend;
+			read_data(nd, ph.offset + (from - ph.vaddr), (uint8_t*)(pg->frame + (from - va)), to - from);
+		}
+		if(va < end)
+		{	//the rest of the segment is only bss
+			if(img->nzeros == EXEC_ZEROS)
+				goto fail;
+			img->zeros[img->nzeros].start = va;
+			img->zeros[img->nzeros].end = end;
+			img->zeros[img->nzeros].rw = rw;
+			img->nzeros++;
+		}
+		end = (end + FRAME_SIZE - 1) & ~(FRAME_SIZE - 1);
+		if(end > img->end)
+			img->end = end;
+	}
+
+	//a page that is bss of a writable segment is writable too
+	for(i = 0; i < img->npages; i++)
+	{
+		for(j = 0; j < img->nzeros; j++)
+		{
+			if(img->pages[i].va >= img->zeros[j].start && img->pages[i].va < img->zeros[j].end)
+				img->pages[i].rw |= img->zeros[j].rw;
+		}
+	}
+
+	img->entry = eh.entry;
+	return 0;
+
+fail:
+	exec_drop(img);
+	return -1;
+}
+
+/*
+ * exec_install
+ * DESCRIPTION: maps a prepared image into the user pages of pid. Every
+ *              instance shares the prepared frames: read-only pages for good,
+ *              writable ones until the first write gets the process its own
+ *              copy. Each mapping holds a reference, dropped in halt.
+ * INPUTS: pinned image, pid
+ * OUTPUTS: none
+ */
+static void exec_install(struct exec_image* img, uint32_t pid)
+{
+	uint32_t i, va;
+	for(i = 0; i < img->nzeros; i++)
+	{
+		for(va = img->zeros[i].start; va < img->zeros[i].end; va += FRAME_SIZE)
+			map_user_zero(pid, va, img->zeros[i].rw);
+	}
+	//after the bss, so pages shared with a bss range are replaced whole
+	for(i = 0; i < img->npages; i++)
+	{
+		get_frame(img->pages[i].frame);
+		map_user_page(pid, img->pages[i].va, img->pages[i].frame,
+			img->pages[i].rw ? (PG_COW | PG_OWNED) : PG_OWNED);
+		kstats.exec_shared++;
+	}
+}
+
+/*
+ * exec_slot
+ * DESCRIPTION: finds the cached image of an executable, or a slot for it,
+ *              dropping the least recently used image if all are taken
+ * INPUTS: inode of the executable, set to 1 if it was cached
+ * OUTPUTS: the slot (pinned), NULL if every slot is pinned
+ */
+static struct exec_image* exec_slot(uint32_t nd, uint32_t* hit)
+{
+	struct exec_image* img = NULL;
+	uint32_t i;
+	for(i = 0; i < EXEC_SLOTS; i++)
+	{
+		if(exec_cache[i].used && exec_cache[i].inode == nd)
+		{
+			*hit = 1;
+			exec_cache[i].pinned = 1;
+			return &exec_cache[i];
+		}
+		if(exec_cache[i].pinned)
+			continue;
+		if(img == NULL || !exec_cache[i].used
+			|| (img->used && exec_cache[i].last < img->last))
+			img = &exec_cache[i];
+	}
+	*hit = 0;
+	if(img == NULL)
+		return NULL;
+	if(img->used)
+	{
+		exec_drop(img);
+		kstats.exec_evicts++;
+	}
+	img->pinned = 1;
+	return img;
+}
+
+/*
+ * exec_cache_shrink
+ * DESCRIPTION: drops the least recently used image that is not in use,
+ *              called by alloc_frame when the frame pool is empty
+ * INPUTS: none
+ * OUTPUTS: 0 if an image was dropped, -1 if there was none to drop
+ */
+int32_t exec_cache_shrink()
+{
+	struct exec_image* img = NULL;
+	uint32_t i;
+	for(i = 0; i < EXEC_SLOTS; i++)
+	{
+		if(!exec_cache[i].used || exec_cache[i].pinned)
+			continue;
+		if(img == NULL || exec_cache[i].last < img->last)
+			img = &exec_cache[i];
+	}
+	if(img == NULL)
+		return -1;
+	exec_drop(img);
+	kstats.exec_evicts++;
+	return 0;
+}
+
+/*
+ * elf_load
+ * DESCRIPTION: loads an executable into the user pages of pid from its
+ *              cached image, building the image on the first launch.
+ *              Executables that don't fit in the cache are read directly.
+ * INPUTS: inode of the executable, pid, where to put the entry point and
+ *         the first page after the image
+ * OUTPUTS: 0 on success, -1 if the file is not a loadable executable or we
+ *          ran out of frames (the caller releases what was mapped)
+ */
+int32_t elf_load(uint32_t nd, uint32_t pid, uint32_t* entry, uint32_t* end)
+{
+	struct exec_image* img;
+	uint32_t hit;
+	int32_t ret;
+	uint64_t start = rdtsc();
+
+	preempt_disable();		/* the cache is shared, but interrupts stay on */
+	img = exec_slot(nd, &hit);
+	if(hit)
+		kstats.exec_hits++;
+	else
+		kstats.exec_misses++;
+
+	if(img != NULL && (hit || exec_build(img, nd) == 0))
+	{
+		img->last = ++exec_launch;
+		*entry = img->entry;
+		*end = img->end;
+		exec_install(img, pid);
+		img->pinned = 0;
+		ret = 0;
+	}
+	else
+	{
+		if(img != NULL)
+			img->pinned = 0;
+		ret = elf_load_direct(nd, pid, entry, end);
+	}
+
+	preempt_enable();
+	kstats.exec_loads++;
+	kstats.exec_cycles += (uint32_t)(rdtsc() - start);
+	return ret;
+}
@@ -0,0 +1,103 @@
+/* elf.h - Defines for loading ELF executables
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _ELF_H
+#define _ELF_H
+
+#include "types.h"
+
+/* Values we check in the ELF header */
+#define ET_EXEC 2       /* executable file */
+#define EM_386 3        /* Intel 80386 */
+
+/* Program header types and flags */
+#define PT_LOAD 1
+#define PF_W 0x2
+
+/* ELF file header, at offset 0 of the file */
+struct elf_header
+{
+	uint8_t ident[16];	//starts with 0x7f 'E' 'L' 'F'
+	uint16_t type;
+	uint16_t machine;
+	uint32_t version;
+	uint32_t entry;
+	uint32_t phoff;		//file offset of the program header table
+	uint32_t shoff;
+	uint32_t flags;
+	uint16_t ehsize;
+	uint16_t phentsize;
+	uint16_t phnum;
+	uint16_t shentsize;
+	uint16_t shnum;
+	uint16_t shstrndx;
+} __attribute__((packed));
+
+/* One entry of the program header table */
+struct elf_phdr
+{
+	uint32_t type;
+	uint32_t offset;	//where the segment starts in the file
+	uint32_t vaddr;
+	uint32_t paddr;
+	uint32_t filesz;	//bytes taken from the file
+	uint32_t memsz;		//bytes in memory, the rest is zeroed (bss)
+	uint32_t flags;
+	uint32_t align;
+} __attribute__((packed));
+
+/*
+ * Executables that were launched before are kept ready to map: the
+ * pages holding file data are built once in frames of their own, and
+ * only the bss ranges and entry point are remembered besides them.
+ * All instances of a program share those frames (writable ones are
+ * copy-on-write). Images are dropped least recently used first when
+ * the frame pool runs dry or a slot is needed; running instances keep
+ * their pages.
+ */
+#define EXEC_SLOTS 8		/* images kept at once */
+#define EXEC_PAGES 64		/* file-backed pages per image (256KiB) */
+#define EXEC_ZEROS 4		/* bss ranges per image */
+
+/* One prepared page of an image */
+struct exec_page
+{
+	uint32_t va;		//user address it is mapped at
+	uint32_t frame;		//its contents, with the bss part already zeroed
+	uint32_t rw;
+};
+
+/* Pages that are only bss, zero-filled on first touch */
+struct exec_zero
+{
+	uint32_t start;
+	uint32_t end;
+	uint32_t rw;
+};
+
+/* A prepared executable */
+struct exec_image
+{
+	uint32_t used;
+	uint32_t pinned;	//being built or copied from, can't be dropped
+	uint32_t last;		//launch number of the last use, for LRU
+	uint32_t inode;
+	uint32_t entry;
+	uint32_t end;		//first page after the image, where the heap starts
+	uint32_t npages;
+	uint32_t nzeros;
+	struct exec_page pages[EXEC_PAGES];
+	struct exec_zero zeros[EXEC_ZEROS];
+};
+
+/* Externally-visible functions */
+
+/* checks that a file is an executable we can run */
+int32_t elf_check(uint32_t inode, struct elf_header* eh);
+/* loads the PT_LOAD segments of an executable into the user pages of pid */
+int32_t elf_load(uint32_t inode, uint32_t pid, uint32_t* entry, uint32_t* end);
+/* drops the least recently used image, 0 if one was dropped */
+int32_t exec_cache_shrink();
+
+#endif /* _ELF_H */
@@ -4,6 +4,7 @@
 
 #include "filesystem.h"
 #include "lib.h"
+#include "stats.h"
 //#include "paging.h"
 
 #define _8MB 0x00800000
@@ -11,18 +12,31 @@
 #define _8KB 0x00002000
 #define _4KB 0x00001000
 
-pcb_t* curr_pcb[6] =
+pcb_t* curr_pcb[MAX_PROCESSES] =
 {
 	(pcb_t*)(_8MB - _8KB),
 	(pcb_t*)(_8MB - 2 * _8KB),
 	(pcb_t*)(_8MB - 3 * _8KB),
 	(pcb_t*)(_8MB - 4 * _8KB),
 	(pcb_t*)(_8MB - 5 * _8KB),
-	(pcb_t*)(_8MB - 6 * _8KB)
+	(pcb_t*)(_8MB - 6 * _8KB),
+	(pcb_t*)(_8MB - 7 * _8KB),
+	(pcb_t*)(_8MB - 8 * _8KB),
+	(pcb_t*)(_8MB - 9 * _8KB),
+	(pcb_t*)(_8MB - 10 * _8KB),
+	(pcb_t*)(_8MB - 11 * _8KB),
+	(pcb_t*)(_8MB - 12 * _8KB),
+	(pcb_t*)(_8MB - 13 * _8KB),
+	(pcb_t*)(_8MB - 14 * _8KB),
+	(pcb_t*)(_8MB - 15 * _8KB),
+	(pcb_t*)(_8MB - 16 * _8KB)
 };  // array of pointers to pcb's
 
 //address of bootblock which is also address of start of filesystem
 static struct bootblock* boot;
+
+//1 if the CPU has SSE prefetch instructions
+static uint32_t has_prefetch;
 /*
  * The next 3 variables were used before the implementation of pcb
  */
@@ -56,7 +70,7 @@ pcb_t* get_pcb() {
 	//0x3FF is 1023, this calculates whether esp is in p0, p1, etc
 	// e / _8KB is 0x3FF if esp is in p0, 0x3FE if in p1, etc.
 	e = 0x3FF - (e / _8KB);
-	if(e >= 6)	//number of shells
+	if(e >= MAX_PROCESSES)
 		return NULL;
 	pcb = curr_pcb[e];
     return pcb;
@@ -128,32 +142,72 @@ int32_t read_dentry_by_index(uint32_t i, struct dentry* dent)
  */
 int32_t read_data(uint32_t nd, uint32_t off, uint8_t* buf, uint32_t len)
 {
-	uint32_t i;
+	uint32_t i, n;
 	struct block* blk;
 	struct inode* nod;
 	if(nd >= boot->nnod)
 		return -1;
 	nod = (struct inode*)(boot + nd + 1);	//inode block is 4096 bytes, offset from boot
-	if(nod->len < len + off)	//if asking for more data than available
+	if(off >= nod->len)	//nothing left past the end of the file
+		return 0;
+	if(nod->len - off < len)	//if asking for more data than available
 	{	//adjusts len to read maximum number of bytes
 		len = nod->len - off;
 	}
 
 	//ptr calculation: since boot is of size 4096 bytes if I add 1 to it it adds 4096 bytes to the address,
 	//therefore I can just add the number of blocks
-	blk = (struct block*)(boot + boot->nnod + 1 + nod->data[off / BLKSIZE]);
-	for(i = 0;len - i > 0;i++)
+	//the inode lists every block directly, so any offset is one lookup away
+	for(i = 0;i < len;i += n)
 	{
-		buf[i] = blk->data[off % BLKSIZE];
-		off++;
-		if(off % BLKSIZE == 0)
-		{	//I can cut the if statement and set the blk ptr every loop too if it saves time
-			blk = (struct block*)(boot + boot->nnod + 1 + nod->data[off / BLKSIZE]);
-		}
+		blk = (struct block*)(boot + boot->nnod + 1 + nod->data[(off + i) / BLKSIZE]);
+		n = BLKSIZE - (off + i) % BLKSIZE;	//rest of the current block
+		if(n > len - i)
+			n = len - i;
+		memcpy(buf + i, blk->data + (off + i) % BLKSIZE, n);
 	}
 	return len;
 }
 
+/*
+ * Fills st with the type, inode, size and block count of a file
+ * Only regular files (type 2) have an inode, everything else has size 0
+ * Inputs: file type, inode#, stat buffer
+ * Outputs: success/failure, changed stat buffer
+ */
+int32_t read_stat(uint32_t ft, uint32_t nd, struct stat* st)
+{
+	struct inode* nod;
+	st->ft = ft;
+	st->ind = nd;
+	st->len = 0;
+	st->nblck = 0;
+	if(ft != 2)
+		return 0;
+	if(nd >= boot->nnod)
+		return -1;
+	nod = (struct inode*)(boot + nd + 1);	//inode block is 4096 bytes, offset from boot
+	st->len = nod->len;
+	st->nblck = (nod->len + BLKSIZE - 1) / BLKSIZE;
+	return 0;
+}
+
+/*
+ * Finds where block i of a file sits in the filesystem image
+ * Inputs: inode#, index of the block within the file
+ * Outputs: address of the block, NULL if the file has no such block
+ */
+uint8_t* file_block(uint32_t nd, uint32_t i)
+{
+	struct inode* nod;
+	if(nd >= boot->nnod)
+		return NULL;
+	nod = (struct inode*)(boot + nd + 1);	//inode block is 4096 bytes, offset from boot
+	if(i >= (nod->len + BLKSIZE - 1) / BLKSIZE)
+		return NULL;
+	return (uint8_t*)(boot + boot->nnod + 1 + nod->data[i]);
+}
+
 /*
  * Loads pointer of boot block, which is the start of a list
  * of 4KiB blocks that make up the filesystem.
@@ -167,8 +221,11 @@ int32_t dir_open(const uint8_t* fn)
 	spawnTbl(fstable);
 	fstable[0].p = 1;		//setup boot block
 	chgDir(2, e);			//puts filesystem in the virtual memory space right after kernel*/
+	uint32_t edx;
 	boot = (struct bootblock*)fn;
 	//dnum = 0;
+	asm volatile("cpuid" : "=d" (edx) : "a" (1) : "ebx", "ecx");
+	has_prefetch = (edx >> 25) & 1;	//SSE bit
 	return 0;
 }
 
@@ -205,6 +262,37 @@ int32_t dir_write(int32_t fd, const void* buf, int32_t n)
 	return -1;
 }
 
+/*
+ * Fills buf with as many dirent records as fit, starting at the
+ * directory index saved in the file position
+ * Inputs: fd, buf, n (size of buf in bytes)
+ * Outputs: bytes written (0 at end of directory), changed buf
+ */
+int32_t dir_getdents(int32_t fd, void* buf, int32_t n)
+{
+	struct dirent* rec = (struct dirent*)buf;
+	struct dentry* d;
+	pcb_t* p = get_pcb();
+	uint32_t i = p->file_desc_tb[fd].file_position;
+	int32_t cnt = 0;
+	if(n < (int32_t)sizeof(struct dirent) && i < boot->nent)
+		return -1;	//not even one record fits
+	while(i < boot->nent && (cnt + 1) * (int32_t)sizeof(struct dirent) <= n)
+	{
+		d = &boot->dirs[i];
+		memcpy(rec->name, d->name, 32);	//maximum size of a filename
+		rec->ft = d->ft;
+		rec->ind = d->ind;
+		//inode block is 4096 bytes, offset from boot
+		rec->len = (d->ft == 2) ? ((struct inode*)(boot + d->ind + 1))->len : 0;
+		rec++;
+		cnt++;
+		i++;
+	}
+	p->file_desc_tb[fd].file_position = i;
+	return cnt * sizeof(struct dirent);
+}
+
 /*
  * "Closes" the filesystem
  * Sets index of last accessed directory to 0
@@ -237,12 +325,72 @@ int32_t file_open(const uint8_t* fn)
 			p->file_desc_tb[i].flag = 1;
 			p->file_desc_tb[i].file_position = 0;
 			p->file_desc_tb[i].inode = d.ind;
+			p->file_desc_tb[i].ra_next = 0;
+			p->file_desc_tb[i].ra_size = 0;
+			p->file_desc_tb[i].ra_end = 0;
 			return i;
 		}
 	}
 	return -1;	//no more available files
 }
 
+/*
+ * Starts reading blocks [blk, blk + n) of a file before they are asked for
+ * The image is already in memory, so this pulls the blocks into the L2
+ * cache only (prefetcht2), leaving L1 to the data being used right now;
+ * a slower block device would queue the reads here instead
+ * Inputs: inode#, first block, number of blocks
+ */
+static void read_ahead(uint32_t nd, uint32_t blk, uint32_t n)
+{
+	uint8_t* b;
+	uint32_t i;
+	for(;n > 0;blk++, n--)
+	{
+		if((b = file_block(nd, blk)) == NULL)
+			return;		//past the end of the file
+		kstats.ra_blocks++;
+		if(!has_prefetch)
+			continue;
+		for(i = 0;i < BLKSIZE;i += 64)	//one prefetch per 64 byte cache line
+			asm volatile("prefetcht2 (%0)" : : "r" (b + i));
+	}
+}
+
+/*
+ * Sequential access detection for file_read
+ * A read starting where the last one stopped is sequential; once less than
+ * half the window is left ahead of it the next window is read ahead, twice
+ * as large as the last one (up to RA_MAX). Any other read drops the window.
+ * Inputs: file descriptor, offset and length of the read that just happened
+ */
+static void file_readahead(struct file_desc* d, uint32_t off, uint32_t len)
+{
+	uint32_t last = (off + len - 1) / BLKSIZE;
+	uint32_t start;
+	if(off != d->ra_next)
+	{	//seeked somewhere else
+		d->ra_size = 0;
+		d->ra_end = 0;
+	}
+	else
+	{
+		kstats.ra_reads++;
+		if(d->ra_size && last < d->ra_end)
+			kstats.ra_hits++;
+		if(last + d->ra_size / 2 >= d->ra_end)
+		{
+			d->ra_size = d->ra_size ? d->ra_size * 2 : RA_MIN;
+			if(d->ra_size > RA_MAX)
+				d->ra_size = RA_MAX;
+			start = (d->ra_end > last + 1) ? d->ra_end : last + 1;
+			d->ra_end = last + 1 + d->ra_size;
+			read_ahead(d->inode, start, d->ra_end - start);
+		}
+	}
+	d->ra_next = off + len;
+}
+
 /*
  * Reads n bytes of data from file into buf
  * Inputs: buf, n	(might remove fd since file is loaded in open()?)
@@ -255,10 +403,53 @@ int32_t file_read(int32_t fd, void* buf, int32_t n)
 		return -1;
 	n = read_data(p->file_desc_tb[fd].inode, p->file_desc_tb[fd].file_position,
 		(uint8_t*)buf, n);
+	if(n <= 0)
+		return n;
+	file_readahead(&p->file_desc_tb[fd], p->file_desc_tb[fd].file_position, n);
 	p->file_desc_tb[fd].file_position += n;
 	return n;
 }
 
+/*
+ * Reads n bytes of data from file into buf starting at off,
+ * without moving the file position
+ * Inputs: fd, buf, n, off
+ * Outputs: number of bytes read, changed buf
+ */
+int32_t file_pread(int32_t fd, void* buf, int32_t n, uint32_t off)
+{
+	pcb_t* p = get_pcb();
+	if(fd > 7 || fd < 2)
+		return -1;
+	return read_data(p->file_desc_tb[fd].inode, off, (uint8_t*)buf, n);
+}
+
+/*
+ * Moves the file position of fd
+ * Inputs: fd, off, whence (SEEK_SET, SEEK_CUR or SEEK_END)
+ * Outputs: new file position, -1 if it would be negative or past INT32_MAX
+ */
+int32_t file_lseek(int32_t fd, int32_t off, int32_t whence)
+{
+	pcb_t* p = get_pcb();
+	int64_t base;
+	if(fd > 7 || fd < 2)
+		return -1;
+	if(whence == SEEK_SET)
+		base = 0;
+	else if(whence == SEEK_CUR)
+		base = p->file_desc_tb[fd].file_position;
+	else if(whence == SEEK_END)
+		base = ((struct inode*)(boot + p->file_desc_tb[fd].inode + 1))->len;
+	else
+		return -1;
+	base += off;	//64 bits wide, so this can't overflow
+	if(base < 0 || base > 0x7FFFFFFF)
+		return -1;
+	p->file_desc_tb[fd].file_position = base;
+	return base;
+}
+
 /*
  * Does nothing
  */
@@ -6,9 +6,20 @@
 #define _FILESYSTEM_H
 
 #include "types.h"
+#include "scheduling.h"
+#include "timer.h"
 
 #define BLKSIZE 4096
 
+/* whence values for file_lseek */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+/* readahead window, in blocks; kept small so it fits in the L2 cache */
+#define RA_MIN 2
+#define RA_MAX 4
+
 struct dentry
 {
 	uint8_t name[32];	//if all 32 chars are filled no '\0'
@@ -37,6 +48,24 @@ struct bootblock
 	struct dentry dirs[63];	//63 groups of 64 bytes
 } __attribute__((packed));
 
+/* One record handed back to the user by getdents */
+struct dirent
+{
+	uint8_t name[32];	//same as dentry, no '\0' if all 32 chars are filled
+	uint32_t ft;
+	uint32_t ind;
+	uint32_t len;		//file size in bytes, 0 for anything but regular files
+} __attribute__((packed));
+
+/* File information handed back to the user by stat/fstat */
+struct stat
+{
+	uint32_t ft;
+	uint32_t ind;
+	uint32_t len;		//file size in bytes, 0 for anything but regular files
+	uint32_t nblck;		//number of data blocks the file occupies
+} __attribute__((packed));
+
 struct fap
 {
 	int32_t (*read)(int32_t fd, void* buf, int32_t nbytes);
@@ -52,6 +81,9 @@ struct file_desc
 	uint32_t inode;
 	uint32_t file_position;
 	uint32_t flag;
+	uint32_t ra_next;	//offset a sequential read would start at
+	uint32_t ra_end;	//first block past the readahead window
+	uint32_t ra_size;	//size of the window in blocks, 0 if there is none
 } __attribute__((packed));
 
 /* Struct for the PCB */
@@ -63,9 +95,27 @@ typedef struct pcb {
     uint32_t saved_esp;
     uint32_t saved_ebp;
     uint32_t active;
+    uint32_t mmap_top;                  // pages used in the mmap region
+    uint32_t brk_start;                 // first heap address, right after the loaded image
+    uint32_t brk;                       // current end of the heap (sbrk)
+    uint32_t big_top;                   // 4MB pages used in the big mmap region
+    uint32_t term;                      // terminal the process reads and writes
+    uint32_t state;                     // TASK_READY, TASK_BLOCKED or TASK_DEAD
+    volatile int32_t* wait;             // flag a blocked process waits on
+    uint32_t level;                     // feedback queue level, 0 runs first
+    uint32_t slice;                     // ticks used of the current quantum
+    int32_t nice;                       // 0..NICE_MAX, higher keeps it lower
+    struct sched_ctx ctx;               // where it stopped when switched away
+    struct ktimer sleep_timer;          // wakes it from nanosleep
+    volatile int32_t sleep_done;        // ...set when it has
+    uint32_t cpu;                       // processor whose run queue it is on
 } pcb_t;
 
-extern pcb_t* curr_pcb[6];
+/* one 8KiB kernel stack each, with the PCB at its bottom, down from 8MiB;
+ * swap keeps the pages of idle ones small, so there can be plenty */
+#define MAX_PROCESSES 16
+
+extern pcb_t* curr_pcb[MAX_PROCESSES];
 
 pcb_t* get_pcb();
 
@@ -79,6 +129,10 @@ int32_t read_dentry_by_index(uint32_t i, struct dentry* dent);
 
 int32_t read_data(uint32_t inode, uint32_t off, uint8_t* buf, uint32_t len);
 
+int32_t read_stat(uint32_t ft, uint32_t inode, struct stat* st);
+
+uint8_t* file_block(uint32_t inode, uint32_t i);
+
 int32_t dir_open(const uint8_t* fn);
 
 int32_t dir_read(int32_t fd, void* buf, int32_t n);
@@ -87,10 +141,16 @@ int32_t dir_write(int32_t fd, const void* buf, int32_t n);
 
 int32_t dir_close(int32_t fd);
 
+int32_t dir_getdents(int32_t fd, void* buf, int32_t n);
+
 int32_t file_open(const uint8_t* fn);
 
 int32_t file_read(int32_t fd, void* buf, int32_t n);
 
+int32_t file_pread(int32_t fd, void* buf, int32_t n, uint32_t off);
+
+int32_t file_lseek(int32_t fd, int32_t off, int32_t whence);
+
 int32_t file_write(int32_t fd, const void* buf, int32_t n);
 
 int32_t file_close(int32_t fd);
@@ -0,0 +1,244 @@
+/* hpet.c - High Precision Event Timer as a clock source and clock event
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#include "hpet.h"
+#include "timer.h"
+#include "rtc.h"
+#include "lib.h"
+#include "pit.h"
+
+static int32_t hpet_probe(void);
+static int32_t hpet_event_probe(void);
+static uint64_t hpet_read(void);
+static void hpet_periodic(void);
+static void hpet_oneshot(uint32_t ns);
+
+/* The main counter, 10MHz or more and (usually) 64 bits wide, but every
+ * read is an uncached access to the chipset */
+struct clocksource hpet_clocksource = {
+    .name = "hpet",
+    .rating = 250,
+    .probe = hpet_probe,
+    .read = hpet_read,
+    .mask = 0xFFFFFFFFFFFFFFFFULL,
+};
+
+/* Comparator 0. Without an IOAPIC to route it to, it can only reach the
+ * 8259 in legacy replacement mode, which also gives IRQ8 to timer 1;
+ * hpet_rtc_periodic then makes up the RTC's interrupt with it. */
+struct clock_event hpet_clock_event = {
+    .name = "hpet",
+    .rating = 200,
+    .irq = PIT_IRQ,
+    .max_ns = TIMER_MAX_NS,
+    .probe = hpet_event_probe,
+    .periodic = hpet_periodic,
+    .oneshot = hpet_oneshot,
+};
+
+/* Local variables */
+static uint32_t hpet_cap = 0;               /* capabilities, 0 if there is no HPET */
+static uint32_t hpet_hz = 0;
+static uint32_t hpet_legacy_on = 0;
+static uint32_t hpet_rtc_delta = 0;         /* counts between RTC interrupts, 0 when off */
+static uint32_t hpet_rtc_oneshot = 0;       /* 1 if timer 1 can't repeat and is set one at a time */
+static uint32_t hpet_rtc_next;              /* ...comparator of the next one */
+
+
+static inline uint32_t hpet_in(uint32_t reg) {
+    return *(volatile uint32_t*)(HPET_BASE + reg);
+}
+
+static inline void hpet_out(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t*)(HPET_BASE + reg) = val;
+}
+
+
+/*
+ * hpet_probe
+ * DESCRIPTION: looks for an HPET at HPET_BASE and starts its counter.
+ *              Nothing there reads back as all ones (or zeros in QEMU),
+ *              neither of which is a valid revision and period.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if there is one, -1 if not
+ * SIDE EFFECTS: sets hpet_clocksource.freq and .mask
+ */
+static int32_t hpet_probe(void) {
+    uint32_t cap = hpet_in(HPET_CAP);
+    uint32_t period = hpet_in(HPET_CAP + 4);
+
+    if (cap == 0xFFFFFFFF || (cap & 0xFF) == 0 || period == 0 || period > HPET_MAX_PERIOD)
+        return -1;
+    hpet_cap = cap;
+    hpet_hz = div_u64(HPET_FS_PER_SEC, period);
+    hpet_clocksource.freq = hpet_hz;
+    if (!(cap & HPET_CAP_64BIT))
+        hpet_clocksource.mask = 0xFFFFFFFF;
+    hpet_out(HPET_CONF, hpet_in(HPET_CONF) | HPET_CONF_ENABLE);
+    return 0;
+}
+
+/*
+ * hpet_read
+ * DESCRIPTION: reads the main counter in two halves, again if the low
+ *              half wrapped in between
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the counter
+ * SIDE EFFECTS: none
+ */
+static uint64_t hpet_read(void) {
+    uint32_t hi, lo;
+
+    if (!(hpet_cap & HPET_CAP_64BIT))
+        return hpet_in(HPET_COUNTER);
+    do {
+        hi = hpet_in(HPET_COUNTER + 4);
+        lo = hpet_in(HPET_COUNTER);
+    } while (hi != hpet_in(HPET_COUNTER + 4));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+
+/*
+ * hpet_event_probe
+ * DESCRIPTION: comparator 0 needs legacy replacement and a periodic mode
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if it can be the clock event device, -1 if not
+ * SIDE EFFECTS: none (hpet_probe ran first)
+ */
+static int32_t hpet_event_probe(void) {
+    if (!(hpet_cap & HPET_CAP_LEGACY) || !(hpet_in(HPET_TN_CONF(0)) & HPET_TN_PERIODIC_CAP))
+        return -1;
+    return 0;
+}
+
+/*
+ * hpet_route
+ * DESCRIPTION: switches on legacy replacement the first time comparator 0
+ *              is used; from then on the PIT and the RTC can't interrupt
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: IRQ0 and IRQ8 come from the HPET
+ */
+static void hpet_route(void) {
+    if (hpet_legacy_on)
+        return;
+    hpet_legacy_on = 1;
+    hpet_out(HPET_CONF, hpet_in(HPET_CONF) | HPET_CONF_LEGACY);
+}
+
+/*
+ * hpet_start
+ * DESCRIPTION: sets comparator n to fire delta counts from now, and then
+ *              every delta counts if periodic. The counter keeps running,
+ *              delta is far longer than the few writes take.
+ * INPUTS: n - timer
+ *         delta - counts
+ *         periodic - 1 to repeat
+ * OUTPUTS: none
+ * RETURN VALUE: the comparator value
+ * SIDE EFFECTS: the timer's interrupt is enabled, edge triggered
+ */
+static uint32_t hpet_start(uint32_t n, uint32_t delta, uint32_t periodic) {
+    uint32_t conf = hpet_in(HPET_TN_CONF(n)) & ~(HPET_TN_PERIODIC | HPET_TN_SETVAL | HPET_TN_LEVEL);
+    uint32_t cmp;
+
+    conf |= HPET_TN_INT | HPET_TN_32BIT;
+    if (periodic)
+        conf |= HPET_TN_PERIODIC | HPET_TN_SETVAL;
+    hpet_out(HPET_TN_CONF(n), conf);
+    cmp = hpet_in(HPET_COUNTER) + delta;
+    hpet_out(HPET_TN_CMP(n), cmp);
+    if (periodic)
+        hpet_out(HPET_TN_CMP(n), delta);    /* second write is the period */
+    return cmp;
+}
+
+static void hpet_periodic(void) {
+    hpet_route();
+    hpet_start(0, hpet_hz / TICK_RATE, 1);
+}
+
+/*
+ * hpet_oneshot
+ * DESCRIPTION: sets comparator 0 to fire once. The comparator only
+ *              matches going forward, so if the counter already passed it
+ *              it is set again further out.
+ * INPUTS: ns - from now
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: one interrupt on IRQ0
+ */
+static void hpet_oneshot(uint32_t ns) {
+    uint32_t delta, cmp;
+
+    hpet_route();
+    if (ns < HPET_MIN_NS)
+        ns = HPET_MIN_NS;
+    delta = div_u64((uint64_t)ns * hpet_hz, NSEC_PER_SEC);
+    do {
+        cmp = hpet_start(0, delta, 0);
+        delta *= 2;
+    } while ((int32_t)(hpet_in(HPET_COUNTER) - cmp) >= 0);
+}
+
+
+/*
+ * hpet_legacy
+ * DESCRIPTION: whether IRQ8 belongs to the HPET
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 1 in legacy replacement mode, 0 if not
+ * SIDE EFFECTS: none
+ */
+uint32_t hpet_legacy(void) {
+    return hpet_legacy_on;
+}
+
+/*
+ * hpet_rtc_periodic
+ * DESCRIPTION: in legacy replacement mode the RTC's interrupt never
+ *              arrives, so timer 1 interrupts on IRQ8 at the rate the RTC
+ *              is run at instead. Timers after 0 don't have to support
+ *              periodic mode; then hpet_rtc_ack sets each next one.
+ * INPUTS: on - 1 to start, 0 to stop
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: programs timer 1
+ */
+void hpet_rtc_periodic(uint32_t on) {
+    uint32_t periodic;
+
+    if (!on) {
+        hpet_rtc_delta = 0;
+        hpet_out(HPET_TN_CONF(1), hpet_in(HPET_TN_CONF(1)) & ~HPET_TN_INT);
+        return;
+    }
+    periodic = hpet_in(HPET_TN_CONF(1)) & HPET_TN_PERIODIC_CAP;
+    hpet_rtc_delta = hpet_hz / RTC_MAX_FREQ;
+    hpet_rtc_oneshot = !periodic;
+    hpet_rtc_next = hpet_start(1, hpet_rtc_delta, periodic != 0);
+}
+
+/*
+ * hpet_rtc_ack
+ * DESCRIPTION: sets the next one-shot of timer 1, one period after the
+ *              last, or one period from now if that is already past
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none if timer 1 is periodic or stopped
+ */
+void hpet_rtc_ack(void) {
+    if (!hpet_rtc_oneshot || hpet_rtc_delta == 0)
+        return;
+    hpet_rtc_next += hpet_rtc_delta;
+    if ((int32_t)(hpet_in(HPET_COUNTER) - hpet_rtc_next) >= 0)
+        hpet_rtc_next = hpet_in(HPET_COUNTER) + hpet_rtc_delta;
+    hpet_out(HPET_TN_CMP(1), hpet_rtc_next);
+}
@@ -0,0 +1,48 @@
+/* hpet.h - High Precision Event Timer
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _HPET_H
+#define _HPET_H
+
+#include "types.h"
+
+/*
+ * Where chipsets (and QEMU) put the HPET. The ACPI HPET table would say
+ * for sure; without it the capabilities register tells whether one is
+ * there. Registers are 64 bits, read and written as two 32-bit halves.
+ */
+#define HPET_BASE			0xFED00000
+#define HPET_CAP			0x000	/* low: capabilities, high: period in fs */
+#define HPET_CONF			0x010
+#define HPET_COUNTER		0x0F0
+#define HPET_TN_CONF(n)		(0x100 + 0x20 * (n))
+#define HPET_TN_CMP(n)		(0x108 + 0x20 * (n))
+
+#define HPET_CAP_64BIT		0x2000	/* main counter is 64 bits */
+#define HPET_CAP_LEGACY		0x8000	/* can take over IRQ0 and IRQ8 */
+#define HPET_MAX_PERIOD		100000000	/* fs, the spec asks for at least 10MHz */
+#define HPET_FS_PER_SEC		1000000000000000ULL
+
+#define HPET_CONF_ENABLE	0x1
+#define HPET_CONF_LEGACY	0x2		/* timer 0 raises IRQ0, timer 1 IRQ8 */
+
+#define HPET_TN_LEVEL		0x002	/* level triggered, we want edges */
+#define HPET_TN_INT			0x004	/* interrupt when the comparator matches */
+#define HPET_TN_PERIODIC	0x008
+#define HPET_TN_PERIODIC_CAP 0x010
+#define HPET_TN_SETVAL		0x040	/* next comparator write also sets the counter of a periodic timer */
+#define HPET_TN_32BIT		0x100
+
+#define HPET_MIN_NS			10000	/* closest a one-shot is set, so it isn't already past */
+
+/* Externally-visible functions */
+
+/* 1 once the HPET took IRQ0 and IRQ8 over from the PIT and the RTC */
+uint32_t hpet_legacy(void);
+/* stands in for the RTC's periodic interrupt on IRQ8, at RTC_MAX_FREQ */
+void hpet_rtc_periodic(uint32_t on);
+/* called by the RTC handler, sets the next RTC interrupt if timer 1 can't repeat */
+void hpet_rtc_ack(void);
+
+#endif /* _HPET_H */
@@ -3,6 +3,9 @@
  */
 
 #include "i8259.h"
+#include "ioapic.h"
+#include "lapic.h"
+#include "irq.h"
 #include "lib.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
@@ -44,11 +47,15 @@ void i8259_init(void) {
     enable_irq(2);
 }
 
-/* Enable (unmask) the specified IRQ */
+/* Enable (unmask) the specified IRQ, on the IOAPIC once it took over */
 void enable_irq(uint32_t irq_num) {
     if (irq_num < 0 || irq_num > 15) {      /* Check if the IRQ is valid */
         return;
     }
+    if (ioapic_on) {
+        ioapic_enable(irq_num);
+        return;
+    }
 
     uint16_t port;
     uint8_t data;
@@ -69,6 +76,10 @@ void disable_irq(uint32_t irq_num) {
     if (irq_num < 0 || irq_num > 15) {      /* Check if the IRQ is valid */
         return;
     }
+    if (ioapic_on) {
+        ioapic_disable(irq_num);
+        return;
+    }
     
     uint16_t port;
     uint8_t data;
@@ -84,11 +95,17 @@ void disable_irq(uint32_t irq_num) {
     outb(data, port);
 }
 
-/* Send end-of-interrupt signal for the specified IRQ */
+/* Send end-of-interrupt signal for the specified IRQ; through the IOAPIC
+ * it is one write to the local APIC instead of one or two port writes */
 void send_eoi(uint32_t irq_num) {
     if (irq_num < 0 || irq_num > 15) {      /* Check if the IRQ is valid */
         return;
     }
+    if (ioapic_on) {
+        lapic_eoi();
+        return;
+    }
+    irq_eoi();
     
     if (irq_num <= 7) {
         outb(EOI | irq_num, MASTER_8259_PORT);
@@ -9,22 +9,26 @@
 #include "rtc.h"
 #include "syscall.h"
 #include "paging.h"
+#include "pit.h"
+#include "lapic.h"
+#include "irq.h"
 
 
 /* Initialize the IDT
- * Set up the IDT with the default exception handlers and the system call handler
+ * Set up the IDT with the exception handlers and the system call handler.
+ * Vectors without one are not present; device interrupts become present
+ * when their drivers irq_register them.
  */
 void idt_init(){
     int i, j;
 
     void (*exceptions[256])(void);          /* Array of pointers to exception handlers */
     for(i = 0; i < 256; i++){
-        exceptions[i] = Default_except;     /* Initialize all exception handlers to default */
+        exceptions[i] = NULL;               /* not present */
     }
 
-    /* Initialize the exception handlers */
+    /* Initialize the exception handlers; 1 (debug) and 15 (reserved) stay absent */
     exceptions[0] = de_handler_wrapper;
-    exceptions[1] = db_handler_wrapper;
     exceptions[2] = nmi_handler_wrapper;
     exceptions[3] = bp_handler_wrapper;
     exceptions[4] = of_handler_wrapper;
@@ -38,14 +42,12 @@ void idt_init(){
     exceptions[12] = ss_handler_wrapper;
     exceptions[13] = gp_handler_wrapper;
     exceptions[14] = pf_handler_wrapper;
-    exceptions[15] = r_handler_wrapper;
     exceptions[16] = mf_handler_wrapper;
     exceptions[17] = ac_handler_wrapper;
     exceptions[18] = mc_handler_wrapper;
     exceptions[19] = xf_handler_wrapper;
-    exceptions[33] = keyboard_handler_wrapper;          /* Initialize keyboard handler */
-    exceptions[40] = rtc_handler_wrapper;               /* Initialize RTC handler */
-    exceptions[128] = syscall_wrapper;                  /* Initialize system call handler */
+    exceptions[IRQ_SYSCALL] = syscall_wrapper;          /* Initialize system call handler */
+    exceptions[LAPIC_SPURIOUS_VECTOR] = lapic_spurious_wrapper;
 
     for(j = 0; j < 256; j++){                           /* Initialize the IDT */
         idt[j].seg_selector = KERNEL_CS;
@@ -62,10 +64,12 @@ void idt_init(){
             idt[j].dpl = 3;
 
         }
-        if(j==0x80 || ((j<=19) && (j!=15 && (j != 1))) || j==33 || j==40){  /* Set present bit for all relevant handlers */
+        if(exceptions[j] != NULL){                      /* Set present bit for all relevant handlers */
             idt[j].present = 1;
+            SET_IDT_ENTRY(idt[j], exceptions[j]);       /* Set the IDT entry */
+        } else {
+            SET_IDT_ENTRY(idt[j], Default_except);
         }
-        SET_IDT_ENTRY(idt[j], exceptions[j]);           /* Set the IDT entry */
     }
 }
 
@@ -86,14 +90,6 @@ void DE()
 }
 
 
-void DB()
-{
-    printf("RESERVED");
-    while(1){}
-    return;
-}
-
-  
 void NMI()
 {
     printf("NMI interrupt");
@@ -193,15 +189,17 @@ void GP(int32_t arg, void* addr)
 
 void PF(int32_t arg, void* addr)
 {
-    printf("Page Fault exception code is %d attempting to access %x\n", arg, (int)addr);
-    while(1){}
-    return;
-}
+    int32_t fixed, opened;
 
-
-void R()
-{
-    printf("Intel RESERVED");
+    /* fixups can decompress or copy a page; a fault taken inside a cli
+     * section belongs to that section's window */
+    opened = irqoff_begin(__FILE__, __LINE__);
+    fixed = page_fault_fixup((uint32_t)addr, arg);
+    if (opened)
+        irqoff_end();
+    if (fixed == 0)
+        return;                                         /* copy-on-write, retry the access */
+    printf("Page Fault exception code is %d attempting to access %x\n", arg, (int)addr);
     while(1){}
     return;
 }
@@ -10,7 +10,6 @@
 /* Initialize the IDT */
 extern void idt_init();
 extern void de_handler_wrapper();
-extern void db_handler_wrapper();
 extern void nmi_handler_wrapper();
 extern void bp_handler_wrapper();
 extern void of_handler_wrapper();
@@ -24,7 +23,6 @@ extern void np_handler_wrapper();
 extern void ss_handler_wrapper();
 extern void gp_handler_wrapper();
 extern void pf_handler_wrapper();
-extern void r_handler_wrapper();
 extern void mf_handler_wrapper();
 extern void ac_handler_wrapper();
 extern void mc_handler_wrapper();
@@ -37,7 +35,6 @@ extern void xf_handler_wrapper();
 /* Exception handlers */
 void Default_except();
 void DE();
-void DB();  
 void NMI();
 void BP();
 void OF();
@@ -51,7 +48,6 @@ void NP();
 void SS();
 void GP();
 void PF();
-void R();
 void MF();
 void AC();     
 void MC();
@@ -0,0 +1,121 @@
+/* ioapic.c - I/O APIC, routing the ISA interrupts to the local APIC
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#include "ioapic.h"
+#include "acpi.h"
+#include "lapic.h"
+#include "i8259.h"
+#include "paging.h"
+#include "lib.h"
+
+/* Externally visible variables */
+uint32_t ioapic_on = 0;
+
+/* Local variables */
+static uint32_t ioapic_base = 0;
+static uint32_t ioapic_pins = 0;            /* redirection entries it has */
+
+
+/* select the register, then go through the window; nothing may come in between */
+static uint32_t ioapic_in(uint32_t reg) {
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    return *(volatile uint32_t*)(ioapic_base + IOAPIC_WIN);
+}
+
+static void ioapic_out(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_REGSEL) = reg;
+    *(volatile uint32_t*)(ioapic_base + IOAPIC_WIN) = val;
+}
+
+
+/*
+ * ioapic_route
+ * DESCRIPTION: sets up the redirection entry of ISA IRQ irq, masked: its
+ *              vector, to the boot processor, and the polarity and trigger
+ *              from the MADT's override, if it had one. IRQs without an
+ *              input of their own (ISA_GSI_NONE) are left out.
+ * INPUTS: irq - ISA IRQ
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+static void ioapic_route(uint32_t irq) {
+    uint32_t gsi = acpi_madt.isa_gsi[irq];
+    uint32_t flags = acpi_madt.isa_flags[irq];
+    uint32_t low = IOAPIC_MASKED | IOAPIC_VECTOR(irq);
+
+    if (gsi >= ioapic_pins)
+        return;
+    if ((flags & MPS_POLARITY) == MPS_ACTIVE_LOW)
+        low |= IOAPIC_ACTIVE_LOW;
+    if ((flags & MPS_TRIGGER) == MPS_LEVEL)
+        low |= IOAPIC_LEVEL;
+    ioapic_out(IOAPIC_REDIR(gsi) + 1, lapic_id() << IOAPIC_DEST_SHIFT);
+    ioapic_out(IOAPIC_REDIR(gsi), low);
+}
+
+/*
+ * ioapic_init
+ * DESCRIPTION: called right after i8259_init, before page_init (see
+ *              acpi_init) and before any device unmasks its IRQ. If the
+ *              MADT has an IOAPIC in the device page, every ISA IRQ is
+ *              routed through it on the vector the 8259 would have used,
+ *              the 8259s are masked for good and the local APIC no
+ *              longer passes them through. Without one, nothing changes.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if the IOAPIC took over, -1 if the 8259 stays
+ * SIDE EFFECTS: enable_irq, disable_irq and send_eoi go to the IOAPIC and
+ *               the local APIC from now on
+ */
+int32_t ioapic_init(void) {
+    uint32_t i, flags;
+
+    if (acpi_init() != 0 || acpi_madt.ioapic_base < DEV_START ||
+            acpi_madt.ioapic_base >= DEV_START + DEV_SIZE || lapic_init() != 0)
+        return -1;
+    ioapic_base = acpi_madt.ioapic_base;
+    ioapic_pins = ((ioapic_in(IOAPIC_VER) >> 16) & 0xFF) + 1;
+
+    cli_and_save(flags);
+    for (i = 0; i < ioapic_pins; i++)
+        ioapic_out(IOAPIC_REDIR(i), IOAPIC_MASKED);
+    for (i = 0; i < ISA_IRQS; i++)
+        ioapic_route(i);
+    if (acpi_madt.pic) {
+        outb(0xFF, MASTER_8259_PORT + 1);
+        outb(0xFF, SLAVE_8259_PORT + 1);
+    }
+    lapic_extint(0);
+    ioapic_on = 1;
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * ioapic_mask
+ * DESCRIPTION: sets or clears the mask bit of ISA IRQ irq's input
+ * INPUTS: irq - ISA IRQ, mask - 1 to mask
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+static void ioapic_mask(uint32_t irq, uint32_t mask) {
+    uint32_t gsi, low, flags;
+
+    if (irq >= ISA_IRQS || (gsi = acpi_madt.isa_gsi[irq]) >= ioapic_pins)
+        return;
+    cli_and_save(flags);
+    low = ioapic_in(IOAPIC_REDIR(gsi));
+    ioapic_out(IOAPIC_REDIR(gsi), mask ? low | IOAPIC_MASKED : low & ~IOAPIC_MASKED);
+    restore_flags(flags);
+}
+
+void ioapic_enable(uint32_t irq) {
+    ioapic_mask(irq, 0);
+}
+
+void ioapic_disable(uint32_t irq) {
+    ioapic_mask(irq, 1);
+}
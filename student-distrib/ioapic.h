@@ -0,0 +1,40 @@
+/* ioapic.h - I/O APIC, routing the ISA interrupts to the local APIC
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _IOAPIC_H
+#define _IOAPIC_H
+
+#include "types.h"
+#include "irq.h"
+
+/* Registers are reached through a select and a window register */
+#define IOAPIC_REGSEL		0x00
+#define IOAPIC_WIN			0x10
+#define IOAPIC_VER			0x01	/* bits 16-23: last redirection entry */
+#define IOAPIC_REDIR(n)		(0x10 + 2 * (n))	/* low half, the high half follows */
+
+/* Redirection entry, low half */
+#define IOAPIC_ACTIVE_LOW	0x2000
+#define IOAPIC_LEVEL		0x8000
+#define IOAPIC_MASKED		0x10000
+/* high half: destination local APIC ID, physical mode */
+#define IOAPIC_DEST_SHIFT	24
+
+/* ISA IRQ n keeps the vector the 8259 gave it, so handlers stay put */
+#define IOAPIC_VECTOR(irq)	IRQ_ISA_VECTOR(irq)
+
+/* Externally-visible variables */
+/* 1 once the IOAPIC delivers the ISA interrupts instead of the 8259 */
+extern uint32_t ioapic_on;
+
+/* Externally-visible functions */
+
+/* takes the ISA interrupts over from the 8259 if the MADT lists an IOAPIC */
+int32_t ioapic_init(void);
+/* unmasks the input of ISA IRQ irq */
+void ioapic_enable(uint32_t irq);
+/* masks it */
+void ioapic_disable(uint32_t irq);
+
+#endif /* _IOAPIC_H */
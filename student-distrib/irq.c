@@ -0,0 +1,118 @@
+/* irq.c - Registering interrupt handlers, and what they cost
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#include "irq.h"
+#include "x86_desc.h"
+#include "smp.h"
+#include "stats.h"
+#include "lib.h"
+
+/* Externally visible variables */
+struct irq_stats irq_stats;
+
+/* Local variables */
+static irq_handler_t irq_handlers[IRQ_SLOTS];
+// slot + 1 of each vector's handler and statistics, 0 if it has none
+static uint8_t irq_slot[IRQ_VECTORS];
+// slot + 1 of the interrupt each processor is in before its EOI, and
+// when its stub was entered
+static uint32_t irq_cur[MAX_CPUS];
+static uint64_t irq_entry[MAX_CPUS];
+
+
+/*
+ * irq_register
+ * DESCRIPTION: points vector's IDT entry at its entry stub and has the
+ *              dispatcher call handler for it. Registering a vector again
+ *              replaces its handler and keeps its statistics.
+ * INPUTS: vector - IRQ_FIRST to IRQ_LAST, not IRQ_SYSCALL
+ *         handler - called with interrupts off and the kernel lock held;
+ *                   it sends its own EOI
+ *         name - for irqstat, cut to IRQ_NAME - 1 characters
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 for a bad vector or if every slot is taken
+ * SIDE EFFECTS: the vector is present in the IDT from now on
+ */
+int32_t irq_register(uint32_t vector, irq_handler_t handler, const char* name) {
+    uint32_t slot, flags;
+
+    if (vector < IRQ_FIRST || vector > IRQ_LAST || vector == IRQ_SYSCALL || handler == NULL)
+        return -1;
+    cli_and_save(flags);
+    slot = irq_slot[vector - IRQ_FIRST];
+    if (slot == 0) {
+        if (irq_stats.nvec == IRQ_SLOTS) {
+            restore_flags(flags);
+            return -1;
+        }
+        slot = ++irq_stats.nvec;
+        irq_stats.vec[slot - 1].vector = vector;
+        irq_slot[vector - IRQ_FIRST] = slot;
+    }
+    irq_handlers[slot - 1] = handler;
+    strncpy(irq_stats.vec[slot - 1].name, (const int8_t*)name, IRQ_NAME - 1);
+
+    SET_IDT_ENTRY(idt[vector], irq_stubs + (vector - IRQ_FIRST) * IRQ_STUB_SIZE);
+    idt[vector].present = 1;
+    restore_flags(flags);
+    return 0;
+}
+
+/*
+ * irq_dispatch
+ * DESCRIPTION: the common part of every registered vector, called by
+ *              irq_common with interrupts off. Takes the kernel lock if
+ *              the interrupt came from user mode or a halted processor,
+ *              counts the interrupt and runs its handler.
+ * INPUTS: vector - the one that came in
+ *         entry - TSC when its stub was entered
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: the handler may switch processes; this returns when the
+ *               interrupted one runs again
+ */
+void irq_dispatch(uint32_t vector, uint64_t entry) {
+    int32_t took = kernel_enter();
+    uint32_t slot = irq_slot[vector - IRQ_FIRST];
+    uint32_t id = smp_id();
+
+    if (slot != 0) {
+        irq_stats.vec[slot - 1].count++;
+        irq_cur[id] = slot;
+        irq_entry[id] = entry;
+        irq_handlers[slot - 1]();
+    }
+    kernel_exit(took);
+}
+
+/*
+ * irq_eoi
+ * DESCRIPTION: adds the time from the running interrupt's entry to its
+ *              EOI to the histogram of its vector. That is how long the
+ *              controller held back that line (and, on the local APIC,
+ *              lower priority ones), including any wait for the kernel
+ *              lock. Only the first EOI after an entry counts.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void irq_eoi(void) {
+    uint32_t id = smp_id();
+    uint32_t slot = irq_cur[id];
+    uint32_t len, b;
+    struct irq_vec_stats* v;
+
+    if (slot == 0)
+        return;
+    irq_cur[id] = 0;
+    len = (uint32_t)(rdtsc() - irq_entry[id]);
+
+    v = &irq_stats.vec[slot - 1];
+    v->eois++;
+    if (len > v->max)
+        v->max = len;
+    for (b = 0; b < IRQ_LAT_BUCKETS - 1 && (len >> (IRQ_LAT_SHIFT + b)) != 0; b++);
+    v->hist[b]++;
+}
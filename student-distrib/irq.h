@@ -0,0 +1,41 @@
+/* irq.h - Registering interrupt handlers, and what they cost
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _IRQ_H
+#define _IRQ_H
+
+/* Vectors a handler can be registered on: everything above the
+ * exceptions but the system call and the local APIC's spurious vector.
+ * Each one has an entry stub in handler_wrapper.S, IRQ_STUB_SIZE bytes
+ * apart, that pushes its vector and goes to irq_common. */
+#define IRQ_FIRST			0x20
+#define IRQ_LAST			0xFE
+#define IRQ_VECTORS			(IRQ_LAST - IRQ_FIRST + 1)
+#define IRQ_SYSCALL			0x80
+#define IRQ_STUB_SIZE		16
+
+/* ISA IRQ n comes in on vector 0x20 + n, through the 8259 or the IOAPIC */
+#define IRQ_ISA_VECTOR(irq)	(IRQ_FIRST + (irq))
+
+#ifndef ASM
+
+#include "types.h"
+
+typedef void (*irq_handler_t)(void);
+
+/* Externally-visible functions */
+
+/* runs handler on vector from now on; name shows up in irqstat. 0 on success */
+int32_t irq_register(uint32_t vector, irq_handler_t handler, const char* name);
+/* called by the entry stubs with the time they were entered */
+void irq_dispatch(uint32_t vector, uint64_t entry);
+/* called by send_eoi and lapic_eoi, ends the running interrupt's latency */
+void irq_eoi(void);
+
+/* In handler_wrapper.S */
+extern uint8_t irq_stubs[];
+
+#endif /* ASM */
+
+#endif /* _IRQ_H */
@@ -11,9 +11,14 @@
 #include "idt.h"
 #include "keyboard.h"
 #include "rtc.h"
+#include "pit.h"
+#include "timer.h"
 #include "paging.h"
 #include "filesystem.h"
 #include "syscall.h"
+#include "smp.h"
+#include "acpi.h"
+#include "ioapic.h"
 
 #define RUN_TESTS
 
@@ -92,7 +97,7 @@ void entry(unsigned long magic, unsigned long addr) {
                 (unsigned)mbi->mmap_addr, (unsigned)mbi->mmap_length);
         for (mmap = (memory_map_t *)mbi->mmap_addr;
                 (unsigned long)mmap < mbi->mmap_addr + mbi->mmap_length;
-                mmap = (memory_map_t *)((unsigned long)mmap + mmap->size + sizeof (mmap->size)))
+                mmap = (memory_map_t *)((unsigned long)mmap + mmap->size + sizeof (mmap->size))) {
             printf("    size = 0x%x, base_addr = 0x%#x%#x\n    type = 0x%x,  length    = 0x%#x%#x\n",
                     (unsigned)mmap->size,
                     (unsigned)mmap->base_addr_high,
@@ -100,6 +105,11 @@ void entry(unsigned long magic, unsigned long addr) {
                     (unsigned)mmap->type,
                     (unsigned)mmap->length_high,
                     (unsigned)mmap->length_low);
+            /* type 1 is usable RAM, keep what is above 4GB for big mappings */
+            if (mmap->type == 1)
+                highmem_add(((uint64_t)mmap->base_addr_high << 32) | mmap->base_addr_low,
+                        ((uint64_t)mmap->length_high << 32) | mmap->length_low);
+        }
     }
 
     /* Construct an LDT entry in the GDT */
@@ -143,8 +153,11 @@ void entry(unsigned long magic, unsigned long addr) {
         ltr(KERNEL_TSS);
     }
 
-    /* Init the PIC */
+    /* Init the PIC, and the IOAPIC if there is one; it reads the ACPI
+     * tables, so before paging */
     i8259_init();
+    if (ioapic_init() == 0)
+        printf("IOAPIC %u routes the ISA interrupts\n", acpi_madt.ioapic_id);
 
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
@@ -153,6 +166,8 @@ void entry(unsigned long magic, unsigned long addr) {
     rtc_init();
     keyboard_init();
     page_init();
+    timer_init();                       /* after paging, the HPET and local APIC registers need it */
+    smp_init();                         /* after the clock, it times the startup IPIs */
     printf("size of dentry: %d, inode: %d, bootblock: %d, data: %d\n", sizeof(struct dentry), sizeof(struct inode), sizeof(struct bootblock), sizeof(struct block));
     
     /* Enable interrupts */
@@ -166,9 +181,10 @@ void entry(unsigned long magic, unsigned long addr) {
         /* Run tests */
         // launch_tests();
     #endif
-    /* Execute the first program ("shell") ... */
-    clear_term();
-    sys_execute((uint8_t*)"shell");
+    /* Execute the first program ("shell") ... the scheduler starts the
+     * shells of the other terminals on its first ticks */
+    term_init();
+    process_execute((uint8_t*)"shell", -1, 0);
 
     /* Spin (nicely, so we don't chew up cycles) */
     asm volatile (".1: hlt; jmp .1;");
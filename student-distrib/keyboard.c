@@ -4,19 +4,22 @@
 
 #include "keyboard.h"
 #include "i8259.h"
+#include "irq.h"
 #include "lib.h"
 #include "types.h"
 #include "terminal.h"
+#include "scheduling.h"
 
 
 /* Local variables */
-// keyboard buffer
-char keyboard_buffer[KEYBOARD_BUFFER_SIZE] = {0};
-// keyboard buffer index
-volatile int keyboard_buffer_index = 0;
+// keyboard buffer of each terminal
+char keyboard_buffer[NUM_TERMS][KEYBOARD_BUFFER_SIZE] = {{0}};
+// keyboard buffer index of each terminal
+volatile int keyboard_buffer_index[NUM_TERMS] = {0};
 // special key flag
 volatile uint8_t key_status = 0;
-volatile int enterpress = 0;
+volatile int enterpress[NUM_TERMS] = {0};
+uint32_t enter_tsc[NUM_TERMS];
 // +-------+------+--------+-----+-----+------+------+-------+
 // |   7   |   6  |   5    |  4  |  3  |  2   |  1   |   0   |
 // +-------+------+--------+-----+-----+------+------+-------+
@@ -112,9 +115,10 @@ unsigned char keymap_upper[KEYBOARD_SCANCODE_SIZE] =
  * INPUTS: none
  * OUTPUTS: none
  * RETURN VALUE: none
- * SIDE EFFECTS: Enables the keyboard IRQ
+ * SIDE EFFECTS: Registers and enables the keyboard IRQ
  */
 void keyboard_init(void) {
+    irq_register(IRQ_ISA_VECTOR(KEYBOARD_IRQ), keyboard_handler, "keyboard");
     enable_irq(KEYBOARD_IRQ);
 }
 
@@ -165,7 +169,15 @@ unsigned char handle_standard_key(uint8_t scancode) {
  */
 void keyboard_handler(void) {
     int i;
-    uint8_t scancode = inb(KEYBOARD_DATA_PORT);     /* read scancde from keyboard data port */
+    uint8_t scancode;
+    uint32_t t = shown_term();              /* typing goes to the terminal on screen */
+    uint32_t out = selected_term();
+    char* kbuf = keyboard_buffer[t];
+    volatile int* kidx = &keyboard_buffer_index[t];
+
+    irqoff_begin(__FILE__, __LINE__);       /* came in through an interrupt gate */
+    select_term(t);                         /* echo on the screen, not where the process writes */
+    scancode = inb(KEYBOARD_DATA_PORT);     /* read scancde from keyboard data port */
     
     // update key_status
     if (scancode & 0x80) {
@@ -219,6 +231,9 @@ void keyboard_handler(void) {
             } else {
                 key_status |= 0x20;
             }
+        } else if ((key_status & 0x08) && scancode >= 0x3B && scancode < 0x3B + NUM_TERMS) {
+            // alt+F1..F3 switches terminals
+            show_term(scancode - 0x3B);
         } else {
             // print the character corresponding to the key pressed
             // check Ctrl+L
@@ -227,43 +242,48 @@ void keyboard_handler(void) {
             } else {
                 // write to terminal (-1 is because there needs space for \n)
                 unsigned char c = handle_standard_key(scancode);
-                if ((c == '\b' && keyboard_buffer_index != 0)) {
-                    if (keyboard_buffer[keyboard_buffer_index - 1] == '\t') {
+                if ((c == '\b' && *kidx != 0)) {
+                    if (kbuf[*kidx - 1] == '\t') {
                         // handle tab backspace
                         for (i = 0; i < 4; i++) {
                             backspace_pressed();
                             move_cursor();
                         }
-                    } else if (keyboard_buffer_index != 0) {
+                    } else if (*kidx != 0) {
                         putc_term(c);
                     }
-                    keyboard_buffer_index--;
+                    (*kidx)--;
                 }
-                else if (keyboard_buffer_index < KEYBOARD_BUFFER_SIZE - 1 && c != '\b') {
+                else if (*kidx < KEYBOARD_BUFFER_SIZE - 1 && c != '\b') {
                     // backspace normal character
                     putc_term(c);
                 }
                 // write to keyboard buffer
-                if (c != 0 && keyboard_buffer_index < KEYBOARD_BUFFER_SIZE - 1 && c != '\b') {
-                    keyboard_buffer[keyboard_buffer_index] = c;
-                    keyboard_buffer_index++;
+                if (c != 0 && *kidx < KEYBOARD_BUFFER_SIZE - 1 && c != '\b') {
+                    kbuf[*kidx] = c;
+                    (*kidx)++;
                 }
 				if (c == '\n')
 				{
-					if(keyboard_buffer_index == KEYBOARD_BUFFER_SIZE - 1)
+					if(*kidx == KEYBOARD_BUFFER_SIZE - 1)
 					{	//edge case if newline is last char
-						keyboard_buffer[keyboard_buffer_index] = c;
-						keyboard_buffer_index++;
+						kbuf[*kidx] = c;
+						(*kidx)++;
 						putc_term(c);
 					}
-                    enterpress = 1;
+                    enterpress[t] = 1;
+                    enter_tsc[t] = (uint32_t)rdtsc();
+                    sched_wake(&enterpress[t]);     // the reader gets a boost
 					// terminal_write(0, keyboard_buffer, keyboard_buffer_index);      // TODO move this into tests.c
-					keyboard_buffer_index = 0;
+					*kidx = 0;
                     // memset(keyboard_buffer, 0, 128);
 				}
             }
         }
     }
 
+    select_term(out);
     send_eoi(KEYBOARD_IRQ);                 /* send EOI */
+    irqoff_end();
+    sched_irq_return();
 }
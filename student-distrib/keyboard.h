@@ -6,6 +6,7 @@
 #define _KEYBOARD_H
 
 #include "types.h"
+#include "lib.h"
 
 /* Keyboard I/O ports */
 #define KEYBOARD_DATA_PORT 0x60
@@ -20,8 +21,11 @@
 #define KEYBOARD_BUFFER_SIZE 128
 
 /* Externally-visible variables */
-extern char keyboard_buffer[128];
-volatile extern int enterpress;
+/* one line buffer per terminal, the keyboard types into the shown one */
+extern char keyboard_buffer[NUM_TERMS][KEYBOARD_BUFFER_SIZE];
+volatile extern int enterpress[NUM_TERMS];
+/* low 32 bits of the tsc when enter was last pressed on each terminal */
+extern uint32_t enter_tsc[NUM_TERMS];
 
 /* Externally-visible functions */
 
@@ -29,7 +33,5 @@ volatile extern int enterpress;
 extern void keyboard_init(void);
 /* Enable (unmask) the keyboard IRQ */
 extern void keyboard_handler(void);
-/* Wrapper function for keyboard_handler */
-extern void keyboard_handler_wrapper();
 
 #endif /* _KEYBOARD_H */
@@ -0,0 +1,236 @@
+/* lapic.c - Local APIC and its timer
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#include "lapic.h"
+#include "timer.h"
+#include "paging.h"
+#include "lib.h"
+#include "scheduling.h"
+#include "smp.h"
+#include "irq.h"
+
+static int32_t lapic_probe(void);
+static void lapic_periodic(void);
+static void lapic_oneshot(uint32_t ns);
+
+/* The timer inside the CPU: no I/O bus in the way and it interrupts the
+ * CPU directly, on its own vector */
+struct clock_event lapic_clock_event = {
+    .name = "lapic",
+    .rating = 300,
+    .irq = -1,
+    .max_ns = TIMER_MAX_NS,
+    .probe = lapic_probe,
+    .periodic = lapic_periodic,
+    .oneshot = lapic_oneshot,
+};
+
+/* Local variables */
+static uint32_t lapic_base = 0;             /* 0 until lapic_init found one */
+static uint32_t lapic_hz = 0;               /* timer counts per second, after the divider */
+static uint32_t lapic_lint0 = LAPIC_EXTINT; /* boot processor's LINT0, masked once the IOAPIC took over */
+
+
+static inline uint32_t lapic_in(uint32_t reg) {
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+static inline void lapic_out(uint32_t reg, uint32_t val) {
+    *(volatile uint32_t*)(lapic_base + reg) = val;
+}
+
+
+/*
+ * lapic_local_init
+ * DESCRIPTION: enables the local APIC of the running processor. On the
+ *              boot processor LINT0 is set to ExtINT so the 8259 keeps
+ *              delivering through it (virtual wire mode) unless the IOAPIC
+ *              took over; the others leave it masked so each IRQ arrives
+ *              once. LINT1 is NMI. They are
+ *              only programmable once the APIC is software-enabled.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: writes the APIC base MSR (each processor has its own)
+ */
+static void lapic_local_init(void) {
+    uint32_t eax, edx;
+
+    asm volatile ("rdmsr" : "=a"(eax), "=d"(edx) : "c"(LAPIC_BASE_MSR));
+    asm volatile ("wrmsr" : : "c"(LAPIC_BASE_MSR), "a"(eax | LAPIC_MSR_ENABLE), "d"(edx));
+
+    lapic_out(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_VECTOR);
+    lapic_out(LAPIC_TPR, 0);
+    lapic_out(LAPIC_LVT_LINT0, (eax & LAPIC_MSR_BSP) ? lapic_lint0 : LAPIC_MASKED);
+    lapic_out(LAPIC_LVT_LINT1, LAPIC_NMI);
+}
+
+/*
+ * lapic_init
+ * DESCRIPTION: finds the boot processor's local APIC and turns it on
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 if there is no local APIC or its
+ *               registers are outside the device page
+ * SIDE EFFECTS: see lapic_local_init
+ */
+int32_t lapic_init(void) {
+    uint32_t eax, edx;
+
+    if (lapic_base != 0)
+        return 0;
+    asm volatile ("cpuid" : "=d"(edx) : "a"(1) : "ebx", "ecx");
+    if (!(edx & (1 << 9)))
+        return -1;
+    asm volatile ("rdmsr" : "=a"(eax), "=d"(edx) : "c"(LAPIC_BASE_MSR));
+    if ((eax & ~0xFFF) < DEV_START || (eax & ~0xFFF) >= DEV_START + DEV_SIZE)
+        return -1;
+    lapic_base = eax & ~0xFFF;
+    lapic_local_init();
+    return 0;
+}
+
+/*
+ * lapic_ap_init
+ * DESCRIPTION: turns on the local APIC of another processor, at the same
+ *              address as the boot processor's, and starts its timer at
+ *              TICK_RATE for its scheduler. All of them run off the same
+ *              bus clock, so the boot processor's calibration holds.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: the timer interrupts once interrupts are enabled
+ */
+void lapic_ap_init(void) {
+    lapic_local_init();
+    lapic_out(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+    lapic_periodic();
+}
+
+/*
+ * lapic_extint
+ * DESCRIPTION: switches the boot processor's LINT0 between passing the
+ *              8259 through and masked
+ * INPUTS: on - 1 for ExtINT
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: call on the boot processor, after lapic_init
+ */
+void lapic_extint(uint32_t on) {
+    lapic_lint0 = on ? LAPIC_EXTINT : LAPIC_MASKED;
+    lapic_out(LAPIC_LVT_LINT0, lapic_lint0);
+}
+
+uint32_t lapic_id(void) {
+    return lapic_base != 0 ? lapic_in(LAPIC_ID) >> 24 : 0;
+}
+
+uint32_t lapic_timer_ok(void) {
+    return lapic_hz != 0;
+}
+
+/*
+ * lapic_ipi
+ * DESCRIPTION: sends an interprocessor interrupt. Writing the low half
+ *              sends it, so the destination goes first.
+ * INPUTS: apic_id - destination, ignored with LAPIC_ICR_OTHERS
+ *         cmd - vector, delivery mode, level and shorthand
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: interrupts must be off, the ICR is shared by both writes
+ */
+void lapic_ipi(uint32_t apic_id, uint32_t cmd) {
+    lapic_out(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_out(LAPIC_ICR_LOW, cmd);
+    while (lapic_in(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)
+        asm volatile ("pause");
+}
+
+void lapic_eoi(void) {
+    irq_eoi();
+    lapic_out(LAPIC_EOI, 0);
+}
+
+
+/*
+ * lapic_probe
+ * DESCRIPTION: the timer's rate depends on the bus clock, so it is timed
+ *              against the clock source: counts down from the top for
+ *              TIMER_CAL_NS with its interrupt masked
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if it can be the clock event device, -1 if not
+ * SIDE EFFECTS: enables the local APIC
+ */
+static int32_t lapic_probe(void) {
+    uint64_t start, ns;
+    uint32_t counted;
+
+    if (lapic_init() != 0)
+        return -1;
+    lapic_out(LAPIC_TIMER_DIV, LAPIC_DIV_16);
+    lapic_out(LAPIC_LVT_TIMER, LAPIC_MASKED | LAPIC_TIMER_VECTOR);
+    lapic_out(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    start = clock_ns();
+    while ((ns = clock_ns() - start) < TIMER_CAL_NS);
+    counted = 0xFFFFFFFF - lapic_in(LAPIC_TIMER_COUNT);
+    lapic_out(LAPIC_TIMER_INIT, 0);         /* stops it */
+
+    lapic_hz = div_u64((uint64_t)counted * NSEC_PER_SEC, (uint32_t)ns);
+    if (lapic_hz == 0)
+        return -1;
+    irq_register(LAPIC_TIMER_VECTOR, lapic_timer_handler, "lapic timer");
+    return 0;
+}
+
+static void lapic_periodic(void) {
+    lapic_out(LAPIC_LVT_TIMER, LAPIC_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_out(LAPIC_TIMER_INIT, lapic_hz / TICK_RATE);
+}
+
+static void lapic_oneshot(uint32_t ns) {
+    uint32_t count = div_u64((uint64_t)ns * lapic_hz, NSEC_PER_SEC);
+
+    lapic_out(LAPIC_LVT_TIMER, LAPIC_TIMER_VECTOR);
+    lapic_out(LAPIC_TIMER_INIT, count != 0 ? count : 1);
+}
+
+
+/*
+ * lapic_timer_handler
+ * DESCRIPTION: Handles the local APIC timer interrupt. On the boot
+ *              processor it is the clock event device; the others only
+ *              use it to charge their own scheduler ticks.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: may switch to another process
+ */
+void lapic_timer_handler(void) {
+    irqoff_begin(__FILE__, __LINE__);       /* came in through an interrupt gate */
+    lapic_eoi();
+    if (smp_id() == 0)
+        timer_interrupt();
+    else
+        sched_tick(1);
+    irqoff_end();
+    sched_irq_return();
+}
+
+/*
+ * lapic_resched_handler
+ * DESCRIPTION: Handles the IPI smp_resched sends when it readied a
+ *              process on this processor's run queue; need_resched is
+ *              already set
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: may switch to another process
+ */
+void lapic_resched_handler(void) {
+    irqoff_begin(__FILE__, __LINE__);
+    lapic_eoi();
+    irqoff_end();
+    sched_irq_return();
+}
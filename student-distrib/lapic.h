@@ -0,0 +1,71 @@
+/* lapic.h - Local APIC
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _LAPIC_H
+#define _LAPIC_H
+
+#include "types.h"
+
+#define LAPIC_BASE_MSR		0x1B
+#define LAPIC_MSR_ENABLE	0x800
+#define LAPIC_MSR_BSP		0x100	/* set on the boot processor */
+
+/* Register offsets from the base */
+#define LAPIC_ID			0x020
+#define LAPIC_TPR			0x080
+#define LAPIC_EOI			0x0B0
+#define LAPIC_SVR			0x0F0
+#define LAPIC_ICR_LOW		0x300
+#define LAPIC_ICR_HIGH		0x310
+#define LAPIC_LVT_TIMER		0x320
+#define LAPIC_LVT_LINT0		0x350
+#define LAPIC_LVT_LINT1		0x360
+#define LAPIC_TIMER_INIT	0x380
+#define LAPIC_TIMER_COUNT	0x390
+#define LAPIC_TIMER_DIV		0x3E0
+
+#define LAPIC_SVR_ENABLE	0x100
+#define LAPIC_MASKED		0x10000
+#define LAPIC_PERIODIC		0x20000
+#define LAPIC_NMI			0x400
+#define LAPIC_EXTINT		0x700	/* LINT0 passes the 8259 through */
+#define LAPIC_DIV_16		0x3
+
+/* Interrupt command register: delivery mode, level and destination */
+#define LAPIC_ICR_FIXED		0x000
+#define LAPIC_ICR_INIT		0x500
+#define LAPIC_ICR_STARTUP	0x600	/* vector is the page to start at */
+#define LAPIC_ICR_PENDING	0x1000	/* delivery status, still sending */
+#define LAPIC_ICR_ASSERT	0x4000
+#define LAPIC_ICR_OTHERS	0xC0000	/* every processor but this one */
+
+/* Vectors, above everything the 8259 and the system call use */
+#define LAPIC_TIMER_VECTOR		0xEF
+#define LAPIC_RESCHED_VECTOR	0xEE
+#define LAPIC_SPURIOUS_VECTOR	0xFF
+
+/* Externally-visible functions */
+
+/* software-enables the local APIC with the 8259 still on LINT0, -1 if there is none */
+int32_t lapic_init(void);
+/* passes the 8259 through LINT0 of the boot processor, or masks it (on = 0) */
+void lapic_extint(uint32_t on);
+/* sets up the local APIC of another processor and starts its tick */
+void lapic_ap_init(void);
+/* ID of this processor's local APIC */
+uint32_t lapic_id(void);
+/* sends an IPI (cmd is the low half of the ICR) to apic_id and waits until it is out */
+void lapic_ipi(uint32_t apic_id, uint32_t cmd);
+/* 1 if the local APIC timer was calibrated and can tick the other processors */
+uint32_t lapic_timer_ok(void);
+/* acknowledges an interrupt delivered by the local APIC */
+void lapic_eoi(void);
+/* local APIC timer interrupt */
+void lapic_timer_handler(void);
+/* IPI sent by smp_resched */
+void lapic_resched_handler(void);
+/* Wrapper functions */
+extern void lapic_spurious_wrapper();
+
+#endif /* _LAPIC_H */
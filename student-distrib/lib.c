@@ -3,15 +3,25 @@
  */
 
 #include "lib.h"
+#include "stats.h"
+#include "smp.h"
 
 #define VIDEO       0xB8000
 #define NUM_COLS    80
 #define NUM_ROWS    25
 #define ATTRIB      0x7
 
+/* the text page after the shown one holds terminal t while it is hidden */
+#define TERM_VIDEO(t) (VIDEO + ((t) + 1) * 0x1000)
+
+/* screen_x, screen_y and video_mem belong to the selected terminal */
 static int screen_x;
 static int screen_y;
 static char* video_mem = (char *)VIDEO;
+static int term_x[NUM_TERMS];           /* cursors of the other terminals */
+static int term_y[NUM_TERMS];
+static uint32_t term_sel = 0;           /* terminal the output goes to */
+static uint32_t term_shown = 0;         /* terminal on the screen */
 
 /* void clear(void);
  * Inputs: void
@@ -476,26 +486,117 @@ void test_interrupts(void) {
     }
 }
 
+/* uint64_t div_u64(uint64_t n, uint32_t d)
+ * Inputs: n -- dividend
+ *         d -- divisor, not 0
+ * Return Value: n / d
+ * Function: 64-bit by 32-bit division in two divl, since the kernel
+ *   isn't linked against libgcc's __udivdi3 */
+uint64_t div_u64(uint64_t n, uint32_t d) {
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t lo = (uint32_t)n;
+    uint32_t qhi = hi / d;
+    uint32_t rem = hi % d;
+
+    asm ("divl %4"                      /* rem:lo / d, rem < d so it fits */
+            : "=a"(lo), "=d"(rem)
+            : "a"(lo), "d"(rem), "rm"(d)
+            : "cc"
+    );
+    return ((uint64_t)qhi << 32) | lo;
+}
+
+#if IRQOFF_TRACK
+static uint64_t irqoff_start = 0;       /* tsc when interrupts went off, 0 if they are on */
+static const char* irqoff_file;         /* where they went off */
+static uint32_t irqoff_line;
+struct irqoff_stats irqoff;
+
+/*
+ * void irqoff_begin(const char* file, uint32_t line)
+ * Description: Notes that interrupts were just turned off at file:line.
+ *   Called by cli/cli_and_save when interrupts were on, and at the top
+ *   of interrupt handlers, which come in with them off. Only the boot
+ *   processor's windows are measured.
+ * Inputs: file, line -- call site
+ * Return: 1 if this opened the window, 0 if one was already open
+ */
+int32_t irqoff_begin(const char* file, uint32_t line) {
+    if (smp_id() != 0)
+        return 0;
+    if (irqoff_start != 0)
+        return 0;                       /* already in a window */
+    irqoff_file = file;
+    irqoff_line = line;
+    irqoff_start = rdtsc();
+    return 1;
+}
+
+/*
+ * void irqoff_end(void)
+ * Description: Closes the open interrupts-off window, if there is one,
+ *   adding it to the histogram and to the longest sites
+ * Inputs: none
+ * Return: none
+ */
+void irqoff_end(void) {
+    uint32_t len, i, b, low = 0;
+    const char* name;
+
+    if (irqoff_start == 0 || smp_id() != 0)
+        return;
+    len = (uint32_t)(rdtsc() - irqoff_start);
+    irqoff_start = 0;
+
+    irqoff.windows++;
+    if (len > irqoff.max)
+        irqoff.max = len;
+    for (b = 0; b < IRQOFF_BUCKETS - 1 && (len >> (IRQOFF_SHIFT + b)) != 0; b++);
+    irqoff.hist[b]++;
+
+    name = irqoff_file;
+    for (i = 0; irqoff_file[i] != '\0'; i++) {
+        if (irqoff_file[i] == '/')
+            name = irqoff_file + i + 1;
+    }
+    /* same site keeps its worst, otherwise replace the shortest one */
+    for (i = 0; i < IRQOFF_SITES; i++) {
+        if (irqoff.sites[i].line == irqoff_line &&
+                !strncmp(irqoff.sites[i].file, (const int8_t*)name, IRQOFF_FILE - 1))
+            break;
+        if (irqoff.sites[i].cycles < irqoff.sites[low].cycles)
+            low = i;
+    }
+    if (i < IRQOFF_SITES) {
+        if (len > irqoff.sites[i].cycles)
+            irqoff.sites[i].cycles = len;
+        return;
+    }
+    if (len <= irqoff.sites[low].cycles)
+        return;
+    irqoff.sites[low].cycles = len;
+    irqoff.sites[low].line = irqoff_line;
+    strncpy(irqoff.sites[low].file, (const int8_t*)name, IRQOFF_FILE - 1);
+    irqoff.sites[low].file[IRQOFF_FILE - 1] = '\0';
+}
+#endif
+
 /*
  * void scroll(void)
  * Description: Scrolls video memory down a line
+ *   Moves whole rows at once: video memory is write-combining, so
+ *   wide copies and stores are what make this fast
  * Inputs: none
  * Return: none
  */
 void scroll_term()
 {
-    // unsigned blank, temp;
-    // blank = 0x20 | (ATTRIB << 8);
-    // temp = screen_y - NUM_ROWS + 1;
-    int32_t i;
-    for(i = 0; i < (NUM_ROWS - 1) * NUM_COLS; i++){
-        *(uint8_t *)(video_mem + (i << 1)) =  *(uint8_t *)(video_mem + ((i + NUM_COLS) << 1));
-    }   // can be replaced with memcpy
-    // memcpy(video_mem, video_mem + temp * NUM_COLS, (NUM_ROWS - temp) * NUM_COLS * 2);
-    for(;i < NUM_ROWS * NUM_COLS; i++){
-        *(uint8_t *)(video_mem + (i << 1)) = ' ';
-    }   // can be replaced with memset
-    // memset(video_mem + (NUM_COLS - temp) * NUM_COLS, blank, NUM_COLS);
+    uint64_t start = rdtsc();
+    // rows move up, dest is below src so a forward copy is safe
+    memcpy(video_mem, video_mem + NUM_COLS * 2, (NUM_ROWS - 1) * NUM_COLS * 2);  // 2 bytes per cell
+    memset_word(video_mem + (NUM_ROWS - 1) * NUM_COLS * 2, ' ' | (ATTRIB << 8), NUM_COLS);
+    kstats.scrolls++;
+    kstats.scroll_cycles += (uint32_t)(rdtsc() - start);
 }
 
 
@@ -508,6 +609,8 @@ void scroll_term()
  */
 void move_cursor(void) {
     int pos;
+    if (term_sel != term_shown)
+        return;                             /* the cursor follows the shown terminal */
     pos = screen_y * NUM_COLS + screen_x;   /* Row-major indexing */
     outb(0x0E, 0x3D4);                      /* Set high byte of VGA cursor */
     outb((pos >> 8) & 0xFF, 0x3D5);         /* Send high byte */
@@ -605,6 +708,70 @@ void puts_term(unsigned char *s) {
 }
 
 
-void term_init(void) {      // might be unnecessary
+/* void term_init(void)
+ * Description: blanks every terminal, shows terminal 0 and sends output there
+ * Inputs: none
+ * Return Value: none
+ */
+void term_init(void) {
+    uint32_t t;
+    for (t = 0; t < NUM_TERMS; t++)
+        memset_word((void*)TERM_VIDEO(t), ' ' | (ATTRIB << 8), NUM_ROWS * NUM_COLS);
     clear_term();
 }
+
+
+/* void select_term(uint32_t t)
+ * Description: sends the output of putc_term (and printf) to terminal t,
+ *   into video memory if it is shown, else into its hidden text page
+ * Inputs: t -- terminal
+ * Return Value: none
+ * Side Effects: the caller keeps interrupts off, the keyboard selects too
+ */
+void select_term(uint32_t t) {
+    if (t == term_sel)
+        return;
+    term_x[term_sel] = screen_x;
+    term_y[term_sel] = screen_y;
+    term_sel = t;
+    screen_x = term_x[t];
+    screen_y = term_y[t];
+    video_mem = (char *)(t == term_shown ? VIDEO : TERM_VIDEO(t));
+}
+
+
+/* uint32_t selected_term(void)
+ * Description: terminal the output goes to now
+ */
+uint32_t selected_term(void) {
+    return term_sel;
+}
+
+
+/* uint32_t shown_term(void)
+ * Description: terminal on the screen, the one the keyboard types into
+ */
+uint32_t shown_term(void) {
+    return term_shown;
+}
+
+
+/* void show_term(uint32_t t)
+ * Description: puts terminal t on the screen, saving the one that was
+ *   there in its hidden page
+ * Inputs: t -- terminal
+ * Return Value: none
+ * Side Effects: the caller keeps interrupts off
+ */
+void show_term(uint32_t t) {
+    uint32_t sel = term_sel;
+    if (t == term_shown || t >= NUM_TERMS)
+        return;
+    memcpy((void*)TERM_VIDEO(term_shown), (void*)VIDEO, NUM_ROWS * NUM_COLS * 2);
+    memcpy((void*)VIDEO, (void*)TERM_VIDEO(t), NUM_ROWS * NUM_COLS * 2);
+    term_shown = t;
+    video_mem = (char *)(sel == t ? VIDEO : TERM_VIDEO(sel));
+    select_term(t);                     /* to put the cursor where t had it */
+    move_cursor();
+    select_term(sel);
+}
@@ -102,14 +102,33 @@ do {                                    \
     );                                  \
 } while (0)
 
-/* Clear interrupt flag - disables interrupts on this processor */
+/* Time how long interrupts stay disabled (see irqoff_begin in lib.c) */
+#define IRQOFF_TRACK 1
+
+#if IRQOFF_TRACK
+int32_t irqoff_begin(const char* file, uint32_t line);
+void irqoff_end(void);
+#else
+#define irqoff_begin(file, line) (0)
+#define irqoff_end() do { } while (0)
+#endif
+
+/* Clear interrupt flag - disables interrupts on this processor
+ * Starts an interrupts-off window if they were on */
 #define cli()                           \
 do {                                    \
-    asm volatile ("cli"                 \
-            :                           \
+    uint32_t cli_flags_;                \
+    asm volatile ("                   \n\
+            pushfl                    \n\
+            popl %0                   \n\
+            cli                       \n\
+            "                           \
+            : "=r"(cli_flags_)          \
             :                           \
             : "memory", "cc"            \
     );                                  \
+    if (cli_flags_ & 0x200)             \
+        irqoff_begin(__FILE__, __LINE__); \
 } while (0)
 
 /* Save flags and then clear interrupt flag
@@ -126,11 +145,14 @@ do {                                    \
             :                           \
             : "memory", "cc"            \
     );                                  \
+    if ((flags) & 0x200)                \
+        irqoff_begin(__FILE__, __LINE__); \
 } while (0)
 
 /* Set interrupt flag - enable interrupts on this processor */
 #define sti()                           \
 do {                                    \
+    irqoff_end();                       \
     asm volatile ("sti"                 \
             :                           \
             :                           \
@@ -143,6 +165,8 @@ do {                                    \
  * after a cli_and_save_flags(flags) */
 #define restore_flags(flags)            \
 do {                                    \
+    if ((flags) & 0x200)                \
+        irqoff_end();                   \
     asm volatile ("                   \n\
             pushl %0                  \n\
             popfl                     \n\
@@ -153,6 +177,18 @@ do {                                    \
     );                                  \
 } while (0)
 
+/* Reads the time stamp counter (cycles since reset) */
+static inline uint64_t rdtsc(void) {
+    uint64_t val;
+    asm volatile ("rdtsc"
+            : "=A"(val)
+    );
+    return val;
+}
+
+/* 64-bit by 32-bit division, the kernel has no __udivdi3 */
+uint64_t div_u64(uint64_t n, uint32_t d);
+
 void test_interrupts(void);
 
 extern void scroll_term(void);
@@ -165,6 +201,15 @@ extern void backspace_pressed(void);
 
 extern void putc_term(unsigned char c);
 
+/* Number of terminals, switched with alt+F1..F3 */
+#define NUM_TERMS 3
+
+extern void term_init(void);
+extern void select_term(uint32_t t);
+extern uint32_t selected_term(void);
+extern uint32_t shown_term(void);
+extern void show_term(uint32_t t);
+
 extern void puts_term(unsigned char *s);
 
 #endif /* _LIB_H */
@@ -3,10 +3,30 @@
  */
 
 #include "paging.h"
+#include "lib.h"
+#include "filesystem.h"
+#include "elf.h"
+#include "stats.h"
+#include "swap.h"
+#include "scheduling.h"
+#include "spinlock.h"
 
 /* Local Variables */
-static union dirEntry pageDir[1024] __attribute__((aligned(4096)));
+static union dirEntry pageDir[1024] __attribute__((aligned(4096)));	/* kernel only, used until the first process */
+static union dirEntry procDir[MAX_PROCESSES][1024] __attribute__((aligned(4096)));	/* kernel part copied from pageDir */
 static union tblEntry table[1024] __attribute__((aligned(4096)));
+static union tblEntry userTbl[MAX_PROCESSES][1024] __attribute__((aligned(4096)));	/* 128MiB program page of each process */
+static union tblEntry mmapTbl[MAX_PROCESSES][1024] __attribute__((aligned(4096)));	/* one per process */
+static uint8_t frameRef[FRAME_COUNT];		/* mappings (and cached images) using the frame, 0 if free */
+static uint32_t zeroPool[ZERO_POOL];		/* frames known to be all zero, allocated but unused */
+static uint32_t zeroDepth;			/* frames in zeroPool */
+static uint32_t freeFrames = FRAME_COUNT;	/* frames with no references */
+static spinlock_t frame_lock = SPINLOCK_INIT;	/* frameRef, zeroPool and the counts, see frame_lock_irqsave */
+static uint32_t scanPid, scanIdx;		/* where swap_out_cold left off */
+static uint32_t highChunk[HIGH_CHUNKS];		/* physical address >> 22 of each 4MiB chunk above 4GiB */
+static uint8_t highUsed[HIGH_CHUNKS];
+static uint32_t highCount;			/* chunks in highChunk */
+static uint32_t has_movnti;			/* SSE2 non-temporal stores available */
 
 
 /*
@@ -20,6 +40,7 @@ static union tblEntry table[1024] __attribute__((aligned(4096)));
  */
 void pageEnable()
 {
+	uint32_t edx;
 	asm(	"movl $pageDir, %eax\n\t"
 		"movl %eax, %cr3\n\t");		/* move the table pointer to cr3 */
 
@@ -28,11 +49,88 @@ void pageEnable()
 		"movl %eax, %cr4\n\t");		/* enables PSE (extention that allows 4MiB pages) */
 	
 	asm(	"movl %cr0, %eax\n\t"
-		"orl $0x80000000, %eax\n\t"
-		"movl %eax, %cr0\n\t");		/* this enables the PG bit */
+		"orl $0x80010000, %eax\n\t"
+		"movl %eax, %cr0\n\t");		/* this enables the PG bit, and WP so the kernel can't write read-only pages */
+
+	asm volatile("cpuid" : "=d" (edx) : "a" (1) : "ebx", "ecx");
+	has_movnti = (edx >> 26) & 1;		/* SSE2 bit */
+	if(!(edx & (1 << 17)))			/* no PSE-36, memory above 4GiB is out of reach */
+		highCount = 0;
+	kstats.high_chunks = highCount;
+	if(edx & (1 << 13))			/* PGE supported */
+	{
+		asm(	"movl %cr4, %eax\n\t"
+			"orl $0x80, %eax\n\t"		/* bit 7 */
+			"movl %eax, %cr4\n\t");	/* enables PGE, g pages survive cr3 loads */
+	}
 	return;
 }
 
+/*
+ * Programs PAT entry 1 (selected by pwt alone) as write-combining
+ * Left alone when the CPU has no PAT. Each processor has its own PAT
+ * and they must all agree, so the others call this too.
+ */
+void pat_init()
+{
+	uint32_t eax, edx;
+	asm volatile("cpuid" : "=d" (edx) : "a" (1) : "ebx", "ecx");
+	if(!(edx & (1 << 16)))		/* PAT supported */
+		return;
+	asm volatile("rdmsr" : "=a" (eax), "=d" (edx) : "c" (PAT_MSR));
+	eax = (eax & ~0xFF00) | (PAT_WC << 8);		/* entry 1 is bits 8-15 */
+	asm volatile(	"wbinvd\n\t"
+			"wrmsr"
+			:
+			: "c" (PAT_MSR), "a" (eax), "d" (edx)
+			: "memory");
+}
+
+/*
+ * Sets the memory type (MEM_WB, MEM_WC or MEM_UC) of the 4KiB pages
+ * covering [addr, addr + len), which must lie in the first 4MiB
+ * (where the devices are mapped 1:1)
+ */
+void map_mem_type(uint32_t addr, uint32_t len, uint32_t type)
+{
+	uint32_t va;
+	for(va = addr & ~(FRAME_SIZE - 1); va < addr + len && va < 0x400000; va += FRAME_SIZE)
+	{
+		table[va / FRAME_SIZE].ent.pwt = type & 1;
+		table[va / FRAME_SIZE].ent.pcd = (type >> 1) & 1;
+		flushPage(va);
+	}
+}
+
+/*
+ * Maps the page at addr (in the kernel's 4MiB) into the first page
+ * table, read-only for users and in every address space, so programs
+ * can read it at TIME_PAGE_USER
+ */
+void map_time_page(uint32_t addr)
+{
+	union tblEntry pg;
+	pg.val = 0x5;			/* p and us, but not rw */
+	pg.ent.g = 1;
+	pg.ent.add = addr >> 12;
+	table[TIME_PAGE_IDX] = pg;
+	flushPage(TIME_PAGE_IDX * FRAME_SIZE);
+}
+
+/*
+ * Maps (or unmaps) the page at addr, below 4MiB, 1:1 and kernel-only in
+ * the first page table, for memory the BIOS owns like the page the
+ * other processors start in
+ */
+void map_low_page(uint32_t addr, uint32_t present)
+{
+	union tblEntry pg;
+	pg.val = present ? 0x3 : 0;	/* p and rw */
+	pg.ent.add = present ? addr >> 12 : 0;
+	table[addr / FRAME_SIZE] = pg;
+	flushPage(addr);
+}
+
 /*
  * This function clears the page directory
  * It is called in page_init()
@@ -83,26 +181,49 @@ void page_init()
 	for(i = 0xB8; i < 0xC0; i++)
 	{
 		vidPg.val = 0x7;		/* this allows the pages to get accessed by users, and is restricted by the vidTable dirEntry */
+		vidPg.ent.g = 1;		/* same in every address space */
 		vidPg.ent.add = i;		/* assigns the physical memory to be the same as virtual memory */
 		table[i] = vidPg;		/* vidmem starts at 0xB8000, divide by 4KiB to get index */
 	}
+	pat_init();
+	map_mem_type(0xB8000, 0x8000, MEM_WC);	/* text mode VGA, written far more than read */
 	spawnDir();
 	pageDir[0] = vidTable;
 	pageDir[1] = kernel;
 	vidTable.ptr.us = 1;
 	pageDir[33] = vidTable; //33 is 132MB/4MB
+	for(i = 0; i < FRAME_POOL_DIRS; i++)
+	{
+		kernel.whole.add_22_31 = (FRAME_POOL >> 22) + i;	/* frame pool, kernel only */
+		pageDir[FRAME_POOL_IDX + i] = kernel;
+	}
+	kernel.whole.add_22_31 = DEV_START >> 22;
+	kernel.whole.pwt = 1;
+	kernel.whole.pcd = 1;		/* MEM_UC, device registers */
+	pageDir[DEV_IDX] = kernel;
+	for(i = 0; i < MAX_PROCESSES; i++)
+	{
+		spawnTbl(userTbl[i]);
+		spawnTbl(mmapTbl[i]);
+		memcpy(procDir[i], pageDir, sizeof(pageDir));
+		procDir[i][USER_IDX].val = (unsigned)userTbl[i] | 7;	/* p, rw and us, each page decides on its own */
+		procDir[i][MMAP_IDX].val = (unsigned)mmapTbl[i] | 7;
+	}
 	pageEnable();
 	return;
 }
 
 /*
- * Changes one entry of the pageDir
+ * Changes one entry of the pageDir, in every process's directory too
  * This allows any kernel program to set up their own pages for their own program,
  * or for a user program that it will call
  */
 void chgDir(uint32_t idx, union dirEntry e)
 {
+	int i;
 	pageDir[idx] = e;
+	for(i = 0; i < MAX_PROCESSES; i++)
+		procDir[i][idx] = e;
 	return;
 }
 
@@ -110,5 +231,616 @@ void flushTLB()
 {
 	asm(	"movl %cr3, %eax\n\t"
 		"movl %eax, %cr3\n\t");		//moves pagedir pointer into cr3 which causes flush
+	kstats.tlb_flushes++;
 	return;
 }
+
+/*
+ * Drops the TLB entry of one page, for changing a single mapping
+ * without losing the rest of the TLB
+ */
+void flushPage(uint32_t addr)
+{
+	asm volatile("invlpg (%0)"
+		:
+		: "r"(addr)
+		: "memory");
+	kstats.tlb_pages++;
+}
+
+/*
+ * Called for each usable region of the multiboot memory map (before page_init)
+ * Keeps the whole 4MiB chunks that lie between 4GiB and HIGH_LIMIT
+ */
+void highmem_add(uint64_t base, uint64_t len)
+{
+	uint64_t end = base + len;
+	if(base < HIGH_START)
+		base = HIGH_START;
+	if(end > HIGH_LIMIT)
+		end = HIGH_LIMIT;
+	base = (base + BIG_SIZE - 1) & ~(uint64_t)(BIG_SIZE - 1);
+	for(; base + BIG_SIZE <= end && highCount < HIGH_CHUNKS; base += BIG_SIZE)
+		highChunk[highCount++] = (uint32_t)(base >> 22);
+}
+
+/*
+ * Returns the 4MiB page directory entry for chunk (physical address >> 22)
+ * PSE-36 puts bits 32-39 of the address in add_32_39
+ */
+static union dirEntry high_entry(uint32_t chunk, uint32_t us, uint32_t rw)
+{
+	union dirEntry e;
+	e.val = 0;
+	e.whole.p = 1;
+	e.whole.rw = rw;
+	e.whole.us = us;
+	e.whole.ps = 1;
+	e.whole.add_22_31 = chunk & 0x3FF;
+	e.whole.add_32_39 = chunk >> 10;
+	return e;
+}
+
+/*
+ * Returns how many chunks above 4GiB are free
+ */
+uint32_t high_avail()
+{
+	uint32_t i, n = 0;
+	for(i = 0; i < highCount; i++)
+		n += !highUsed[i];
+	return n;
+}
+
+/*
+ * Maps a free chunk above 4GiB at vaddr for pid, zeroed through the kernel window
+ * vaddr is in the big region; the caller checked high_avail
+ * Output: 0 on success, -1 if no chunk is free
+ */
+int32_t map_user_big(uint32_t pid, uint32_t vaddr, uint32_t rw)
+{
+	uint32_t i;
+	for(i = 0; i < highCount && highUsed[i]; i++);
+	if(i == highCount)
+		return -1;
+	highUsed[i] = 1;
+	kstats.high_used++;
+	chgDir(HIGH_WINDOW_IDX, high_entry(highChunk[i], 0, 1));
+	flushPage(HIGH_WINDOW_IDX << 22);
+	memset((void*)(HIGH_WINDOW_IDX << 22), 0, BIG_SIZE);
+	procDir[pid][vaddr >> 22] = high_entry(highChunk[i], 1, rw);
+	return 0;
+}
+
+/*
+ * Gives back the chunk above 4GiB a big region entry maps and clears it
+ */
+static void drop_big(union dirEntry* e)
+{
+	uint32_t j, chunk;
+	if(!e->whole.p)
+		return;
+	chunk = e->whole.add_22_31 | (e->whole.add_32_39 << 10);
+	for(j = 0; j < highCount; j++)
+	{
+		if(highChunk[j] == chunk && highUsed[j])
+		{
+			highUsed[j] = 0;
+			kstats.high_used--;
+			break;
+		}
+	}
+	e->val = 0;
+}
+
+/*
+ * Unmaps the 4MiB page at vaddr (in the big region) of pid, giving its
+ * chunk back; it may be in use by the current process, so the TLB entry goes too
+ */
+void unmap_user_big(uint32_t pid, uint32_t vaddr)
+{
+	drop_big(&procDir[pid][vaddr >> 22]);
+	flushPage(vaddr);
+}
+
+/*
+ * Gives back the chunks above 4GiB mapped in the big region of pid
+ */
+static void release_big(uint32_t pid)
+{
+	uint32_t i;
+	for(i = BIG_IDX; i < BIG_IDX + BIG_DIRS; i++)
+		drop_big(&procDir[pid][i]);
+}
+
+/*
+ * The frame pool has its own lock, so an idle processor can zero frames
+ * without the kernel lock while the others allocate and free them
+ * Interrupts stay off while it is held, a handler might want it too
+ */
+static uint32_t frame_lock_irqsave()
+{
+	uint32_t flags;
+	cli_and_save(flags);
+	spin_lock(&frame_lock);
+	return flags;
+}
+
+static void frame_unlock_irqrestore(uint32_t flags)
+{
+	spin_unlock(&frame_lock);
+	restore_flags(flags);
+}
+
+/*
+ * Takes a frame nobody uses, 0 if there is none
+ */
+static uint32_t frame_take()
+{
+	int i;
+	uint32_t frame = 0, flags = frame_lock_irqsave();
+	for(i = 0; i < FRAME_COUNT; i++)
+	{
+		if(!frameRef[i])
+		{
+			frameRef[i] = 1;
+			freeFrames--;
+			frame = FRAME_POOL + i * FRAME_SIZE;
+			break;
+		}
+	}
+	frame_unlock_irqrestore(flags);
+	return frame;
+}
+
+/*
+ * Takes a frame out of the pre-zeroed pool, 0 if it is empty
+ */
+static uint32_t zero_pool_take()
+{
+	uint32_t frame = 0, flags = frame_lock_irqsave();
+	if(zeroDepth > 0)
+	{
+		kstats.zero_depth = --zeroDepth;
+		frame = zeroPool[zeroDepth];
+	}
+	frame_unlock_irqrestore(flags);
+	return frame;
+}
+
+/*
+ * Takes a free 4KiB frame out of the frame pool
+ * When the pool is empty, cached executable images are dropped and cold
+ * pages swapped out to make room; pre-zeroed frames are kept for the
+ * faults that need them and only used up when nothing else is left
+ * Returns the physical (and kernel virtual) address, or 0 if out of frames
+ */
+uint32_t alloc_frame()
+{
+	uint32_t frame;
+	preempt_disable();
+	while((frame = frame_take()) == 0)
+	{
+		if(exec_cache_shrink() != 0 && swap_out_cold(SWAP_BATCH, 0) == 0)
+		{
+			if((frame = zero_pool_take()) != 0)
+				kstats.zero_spent++;
+			break;
+		}
+	}
+	preempt_enable();
+	return frame;
+}
+
+/*
+ * Takes a frame only if one is free: never uses up pre-zeroed frames,
+ * drops images or swaps, so swap itself can grow its storage with it
+ * Returns the address, or 0 if there is none
+ */
+uint32_t alloc_free_frame()
+{
+	return frame_take();
+}
+
+/*
+ * Returns how many frames nobody uses
+ */
+uint32_t free_frames()
+{
+	return freeFrames;
+}
+
+/*
+ * Clears a frame with non-temporal stores, which go around the cache:
+ * the page is not touched again until some process faults it in, so
+ * there is no point filling the cache with its zeroes
+ */
+static void zero_frame(uint32_t frame)
+{
+	uint32_t n = FRAME_SIZE / 16;		/* 16 bytes per loop */
+	if(!has_movnti)
+	{
+		memset((void*)frame, 0, FRAME_SIZE);
+		return;
+	}
+	asm volatile(	"1:\n\t"
+			"movnti %%eax, (%%edi)\n\t"
+			"movnti %%eax, 4(%%edi)\n\t"
+			"movnti %%eax, 8(%%edi)\n\t"
+			"movnti %%eax, 12(%%edi)\n\t"
+			"addl $16, %%edi\n\t"
+			"decl %%ecx\n\t"
+			"jnz 1b\n\t"
+			"sfence"		/* make the stores visible before the frame is used */
+			: "+D" (frame), "+c" (n)
+			: "a" (0)
+			: "memory", "cc");
+}
+
+/*
+ * Takes a zeroed frame, from the pre-zeroed pool when it has one
+ * Returns the address, or 0 if out of frames
+ */
+uint32_t alloc_zeroed_frame()
+{
+	uint32_t frame;
+	if((frame = zero_pool_take()) != 0)
+	{
+		kstats.zero_hits++;
+		return frame;
+	}
+	kstats.zero_empty++;
+	if((frame = alloc_frame()) != 0)
+		memset((void*)frame, 0, FRAME_SIZE);
+	return frame;
+}
+
+/*
+ * Zeroes up to n free frames into the pre-zeroed pool
+ * Called while the kernel has nothing else to do; only takes frames
+ * nobody uses, never drops cached images for it. Needs only the frame
+ * lock, and not while a frame is being zeroed
+ * Returns how many frames were added
+ */
+uint32_t zero_pool_refill(uint32_t n)
+{
+	uint32_t i, frame, flags;
+	for(i = 0; i < n && zeroDepth < ZERO_POOL; i++)
+	{
+		if((frame = frame_take()) == 0)
+			break;
+		zero_frame(frame);
+		flags = frame_lock_irqsave();
+		if(zeroDepth == ZERO_POOL)
+		{	/* another processor filled it meanwhile */
+			frameRef[(frame - FRAME_POOL) / FRAME_SIZE] = 0;
+			freeFrames++;
+			frame_unlock_irqrestore(flags);
+			break;
+		}
+		zeroPool[zeroDepth] = frame;
+		kstats.zero_depth = ++zeroDepth;
+		kstats.zero_filled++;
+		frame_unlock_irqrestore(flags);
+	}
+	return i;
+}
+
+/*
+ * Returns the reference count slot of a pool frame, NULL if addr isn't one
+ */
+static uint8_t* frame_ref(uint32_t addr)
+{
+	if(addr < FRAME_POOL || addr >= FRAME_POOL + FRAME_COUNT * FRAME_SIZE)
+		return NULL;
+	return &frameRef[(addr - FRAME_POOL) / FRAME_SIZE];
+}
+
+/*
+ * Takes one more reference to a frame from alloc_frame, for sharing it
+ */
+void get_frame(uint32_t addr)
+{
+	uint8_t* r = frame_ref(addr);
+	uint32_t flags = frame_lock_irqsave();
+	if(r != NULL)
+		(*r)++;
+	frame_unlock_irqrestore(flags);
+}
+
+/*
+ * Drops a reference to a frame from alloc_frame
+ * The frame goes back in the pool when the last one is gone
+ */
+void free_frame(uint32_t addr)
+{
+	uint8_t* r = frame_ref(addr);
+	uint32_t flags = frame_lock_irqsave();
+	if(r != NULL && *r > 0 && --(*r) == 0)
+		freeFrames++;
+	frame_unlock_irqrestore(flags);
+}
+
+/*
+ * Finds the page table entry for a user address of process pid
+ * Covers the program page (128MiB) and the mmap region (136MiB)
+ * Returns NULL for any other address
+ */
+static union tblEntry* user_pte(uint32_t pid, uint32_t vaddr)
+{
+	if(vaddr >= USER_START && vaddr < USER_START + USER_PAGES * FRAME_SIZE)
+		return &userTbl[pid][(vaddr - USER_START) / FRAME_SIZE];
+	if(vaddr >= MMAP_START && vaddr < MMAP_START + MMAP_PAGES * FRAME_SIZE)
+		return &mmapTbl[pid][(vaddr - MMAP_START) / FRAME_SIZE];
+	return NULL;
+}
+
+/*
+ * Maps the 4KiB page at paddr read-only at vaddr in the user pages of pid
+ * avl holds PG_COW/PG_OWNED, a PG_OWNED frame must have a reference taken for it;
+ * the caller flushes the TLB when done
+ */
+void map_user_page(uint32_t pid, uint32_t vaddr, uint32_t paddr, uint32_t avl)
+{
+	union tblEntry e;
+	e.val = 0;
+	e.ent.p = 1;
+	e.ent.us = 1;		/* rw stays 0, writes fault so PG_COW pages can be copied */
+	e.ent.avl = avl;
+	e.ent.add = paddr >> 12;
+	*user_pte(pid, vaddr) = e;
+}
+
+/*
+ * Makes sure the page at vaddr of pid has a frame, allocating a zeroed one if not
+ * A page that is already there (two segments sharing a page) is reused
+ * Inputs: pid, user address, 1 if the user may write the page
+ * Output: address of the frame (the kernel can access it directly), 0 if out of frames
+ */
+uint32_t map_user_frame(uint32_t pid, uint32_t vaddr, uint32_t rw)
+{
+	union tblEntry* e = user_pte(pid, vaddr);
+	uint32_t frame;
+	if(e->ent.p)
+	{
+		e->ent.rw |= rw;
+		return e->ent.add << 12;
+	}
+	if((frame = alloc_zeroed_frame()) == 0)
+		return 0;
+	e->ent.rw |= rw;
+	e->ent.p = 1;
+	e->ent.us = 1;
+	e->ent.avl = PG_OWNED;
+	e->ent.add = frame >> 12;
+	return frame;
+}
+
+/*
+ * Reserves the page at vaddr of pid without giving it a frame yet
+ * The first access faults and gets a zeroed frame (bss and stack)
+ */
+void map_user_zero(uint32_t pid, uint32_t vaddr, uint32_t rw)
+{
+	union tblEntry* e = user_pte(pid, vaddr);
+	e->ent.rw |= rw;
+	if(e->ent.p)
+		return;		/* already backed, by another segment */
+	e->ent.us = 1;
+	e->ent.avl = PG_ZERO;	/* p stays 0, the CPU ignores the rest of the entry */
+}
+
+/*
+ * Clears a user page table entry, dropping its frame or swap slot
+ */
+static void drop_entry(union tblEntry* e)
+{
+	if(e->ent.p && (e->ent.avl & PG_OWNED))
+		free_frame(e->ent.add << 12);
+	else if(!e->ent.p && e->ent.avl == PG_SWAP)
+		swap_drop(e->ent.add);
+	e->val = 0;
+}
+
+/*
+ * Removes the page at vaddr from the user pages of pid, dropping its frame
+ * The page may be in use by the current process, so its TLB entry goes too
+ */
+void unmap_user_page(uint32_t pid, uint32_t vaddr)
+{
+	drop_entry(user_pte(pid, vaddr));
+	flushPage(vaddr);
+}
+
+/*
+ * Checks that the kernel may touch [addr, addr + len) on behalf of pid:
+ * every page is present or faults in (zero-fill, swap, copy on write),
+ * in the program pages, the mmap region or a 4MiB page of the big region
+ * With write set the pages must also be writable, WP faults otherwise
+ * Output: 1 if so, 0 if not
+ */
+int32_t user_range_ok(uint32_t pid, uint32_t addr, uint32_t len, uint32_t write)
+{
+	union tblEntry* e;
+	union dirEntry* d;
+	uint32_t va, end = addr + len;
+	if(len == 0)
+		return 1;
+	if(end < addr)
+		return 0;		/* wraps around */
+	for(va = addr & ~(FRAME_SIZE - 1); va < end; va += FRAME_SIZE)
+	{
+		if(va >= BIG_START && va < BIG_START + BIG_DIRS * BIG_SIZE)
+		{
+			d = &procDir[pid][va >> 22];
+			if(!d->whole.p || (write && !d->whole.rw))
+				return 0;
+			continue;
+		}
+		if((e = user_pte(pid, va)) == NULL)
+			return 0;
+		if(!e->ent.p && e->ent.avl != PG_ZERO && e->ent.avl != PG_SWAP)
+			return 0;		/* not mapped */
+		if(write && !e->ent.rw && !(e->ent.p && (e->ent.avl & PG_COW)))
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Switches to the address space of pid by loading its page directory
+ * into cr3, which also flushes the (non-global) TLB entries
+ */
+void user_switch(uint32_t pid)
+{
+	asm volatile("movl %0, %%cr3"
+		:
+		: "r"(procDir[pid])
+		: "memory");
+	kstats.tlb_flushes++;
+}
+
+/*
+ * Frees every frame (and swap slot) owned by a page table and clears it
+ */
+static void release_table(union tblEntry tab[1024])
+{
+	int i;
+	for(i = 0; i < 1024; i++)
+		drop_entry(&tab[i]);
+}
+
+/*
+ * Looks at one page for swap_out_cold: a private page that wasn't
+ * accessed since the last look is compressed, one that was gets its
+ * accessed bit cleared (a second chance)
+ * Returns 1 if the page went to swap
+ */
+static uint32_t swap_page(union tblEntry* e, uint32_t may_grow)
+{
+	int32_t slot;
+	uint32_t frame = e->ent.add << 12;
+	if(!e->ent.p || e->ent.avl != PG_OWNED || *frame_ref(frame) != 1)
+		return 0;		/* shared, copy-on-write or not ours */
+	if(e->ent.a)
+	{
+		e->ent.a = 0;
+		return 0;
+	}
+	if((slot = swap_store(frame, may_grow)) < 0)
+		return 0;
+	free_frame(frame);
+	e->ent.p = 0;
+	e->ent.d = 0;
+	e->ent.avl = PG_SWAP;
+	e->ent.add = slot;
+	return 1;
+}
+
+/*
+ * Walks the program and mmap pages of every process that is alive but not
+ * running on any processor (waiting in execute, for input, or for their
+ * turn) and sends cold pages to compressed swap. Their TLB entries went
+ * away when the processor switched off them, so no flush is needed.
+ * Inputs: most pages to look at, 1 if swap may take new storage frames
+ * Output: number of pages swapped out
+ */
+uint32_t swap_out_cold(uint32_t n, uint32_t may_grow)
+{
+	uint32_t looked, done = 0;
+	if(get_pcb() == NULL)
+		return 0;
+	for(looked = 0; looked < n * SCAN_PAGES && done < n; looked++)
+	{
+		if(++scanIdx >= SCAN_PAGES)
+		{
+			scanIdx = 0;
+			scanPid = (scanPid + 1) % MAX_PROCESSES;
+		}
+		if(sched_on_cpu(scanPid) || !curr_pcb[scanPid]->active)
+		{
+			scanIdx = SCAN_PAGES - 1;	/* skip the whole process */
+			looked += SCAN_PAGES - 1;
+			continue;
+		}
+		if(scanIdx < USER_PAGES)
+			done += swap_page(&userTbl[scanPid][scanIdx], may_grow);
+		else		/* anonymous mmap pages are as private as the program's */
+			done += swap_page(&mmapTbl[scanPid][scanIdx - USER_PAGES], may_grow);
+	}
+	return done;
+}
+
+/*
+ * Drops every user mapping of pid, giving its frames back to the pool
+ */
+void user_release(uint32_t pid)
+{
+	release_table(userTbl[pid]);
+	release_table(mmapTbl[pid]);
+	release_big(pid);
+}
+
+/*
+ * Called from the page fault handler
+ * A write to a PG_COW page gets a private copy of the page,
+ * the first touch of a PG_ZERO page gets a zeroed frame
+ * and a PG_SWAP page is decompressed back into a frame
+ * Inputs: faulting address (cr2) and the error code
+ * Output: 0 if the fault was resolved, -1 if it is a real fault
+ */
+int32_t page_fault_fixup(uint32_t addr, uint32_t err)
+{
+	union tblEntry* e;
+	uint32_t frame;
+	pcb_t* p = get_pcb();
+	if(p == NULL || (e = user_pte(p->pid, addr)) == NULL)
+		return -1;
+	if(!(err & 0x1) && !e->ent.p && e->ent.avl == PG_SWAP)
+	{	/* compressed in swap */
+		if((frame = alloc_frame()) == 0)
+			return -1;
+		if(swap_load(e->ent.add, frame))
+		{
+			free_frame(frame);
+			return -1;
+		}
+		e->ent.add = frame >> 12;
+		e->ent.avl = PG_OWNED;
+		e->ent.p = 1;
+		flushPage(addr);
+		return 0;
+	}
+	if(!(err & 0x1) && !e->ent.p && e->ent.avl == PG_ZERO)
+	{	/* not present yet */
+		if((frame = alloc_zeroed_frame()) == 0)
+			return -1;
+		e->ent.add = frame >> 12;
+		e->ent.avl = PG_OWNED;
+		e->ent.p = 1;
+		flushPage(addr);
+		return 0;
+	}
+	if((err & 0x3) != 0x3)		/* otherwise only writes to present pages */
+		return -1;
+	if(!e->ent.p || !(e->ent.avl & PG_COW))
+		return -1;
+	if((e->ent.avl & PG_OWNED) && *frame_ref(e->ent.add << 12) == 1)
+	{	/* nobody else uses the frame any more, just take it */
+		e->ent.rw = 1;
+		e->ent.avl = PG_OWNED;
+		flushPage(addr);
+		return 0;
+	}
+	if((frame = alloc_frame()) == 0)
+		return -1;
+	memcpy((void*)frame, (void*)(e->ent.add << 12), FRAME_SIZE);
+	if(e->ent.avl & PG_OWNED)
+		free_frame(e->ent.add << 12);	/* drop our share of the original */
+	kstats.cow_copies++;
+	e->ent.add = frame >> 12;
+	e->ent.rw = 1;
+	e->ent.avl = PG_OWNED;
+	flushPage(addr);
+	return 0;
+}
@@ -101,9 +101,93 @@ union tblEntry
 };
 
 
+/*
+ * User pages are 4KiB frames from one pool at 8-32MiB (where the six
+ * fixed 4MiB program slots used to be), mapped 1:1 and kernel-only so
+ * the kernel can fill them.
+ */
+#define FRAME_POOL	0x00800000
+#define FRAME_POOL_IDX	2		/* 8MiB / 4MiB */
+#define FRAME_POOL_DIRS	6		/* 4MiB pages covering the pool */
+#define FRAME_COUNT	6144
+#define FRAME_SIZE	0x1000
+
+/*
+ * Each process has a page directory of its own, sharing the kernel
+ * entries, and two page tables: the program page at 128MiB (loaded
+ * segments, bss, stack) and the 4MiB right after the vidmap page
+ * (136MiB), used for mmap'd files
+ */
+#define USER_START	0x08000000
+#define USER_IDX	32		/* 128MiB / 4MiB */
+#define USER_PAGES	1024
+#define USER_STACK_PAGES 64		/* 256KiB below 132MiB, filled on demand */
+#define USER_STACK	(USER_START + (USER_PAGES - USER_STACK_PAGES) * FRAME_SIZE)	/* lowest stack page */
+#define MMAP_START	0x08800000
+#define MMAP_IDX	34		/* 136MiB / 4MiB */
+#define MMAP_PAGES	1024
+#define SCAN_PAGES	(USER_PAGES + MMAP_PAGES)	/* what swap_out_cold walks of a process */
+
+/*
+ * Memory types for map_mem_type, as the PAT index the pwt and pcd bits
+ * select (pwt | pcd << 1). Entry 1 is reprogrammed from write-through
+ * to write-combining at boot; without a PAT it stays write-through.
+ */
+#define MEM_WB		0		/* write-back, the default */
+#define MEM_WC		1		/* write-combining, for framebuffers */
+#define MEM_UC		3		/* uncached, for device registers */
+#define PAT_MSR		0x277
+#define PAT_WC		0x01		/* PAT encoding of write-combining */
+
+/*
+ * Memory above 4GiB (from the multiboot memory map) is used in 4MiB
+ * chunks with PSE-36, which puts physical address bits 32-39 of a 4MiB
+ * page in add_32_39. Our 4KiB page tables can't reach it, so it only
+ * backs big anonymous mmaps, one 4MiB page directory entry each, in
+ * the region after the mmap region. The kernel reaches a chunk through
+ * a 4MiB window at 32MiB, only to zero it.
+ */
+#define HIGH_START	0x100000000ULL
+#define HIGH_LIMIT	0x1000000000ULL	/* 36 bits, what every PSE-36 CPU can address */
+#define HIGH_CHUNKS	1024		/* 4GiB of it at most */
+#define HIGH_WINDOW_IDX	8		/* 32MiB, just above the frame pool */
+#define BIG_START	0x09000000	/* 144MiB */
+#define BIG_IDX		36
+#define BIG_DIRS	16		/* 64MiB per process */
+#define BIG_SIZE	0x400000
+
+/*
+ * Frames zeroed ahead of time while the kernel is idle, so faults and
+ * execute don't have to clear pages themselves
+ */
+#define ZERO_POOL	256		/* 1MiB of clean frames at most */
+#define ZERO_BATCH	4		/* frames zeroed per idle call */
+
+/*
+ * The 4MiB at 0xFEC00000 hold the registers of the IOAPIC, the HPET and
+ * the local APIC. Mapped 1:1, kernel only and uncached.
+ */
+#define DEV_START	0xFEC00000
+#define DEV_IDX		1019		/* 0xFEC00000 / 4MiB */
+#define DEV_SIZE	0x400000
+
+/*
+ * The clock's page (see timer.c) is mapped read-only for users in the
+ * first page table, right after video memory. Programs see it 132MiB
+ * up, through the vidmap directory entry.
+ */
+#define TIME_PAGE_IDX	0xC0
+#define TIME_PAGE_USER	(0x08400000 + TIME_PAGE_IDX * FRAME_SIZE)
+
+/* avl bits of a pgTblEntry */
+#define PG_COW		0x1		/* read-only until the first write, then copied */
+#define PG_OWNED	0x2		/* frame came from the frame pool, holds a reference to it */
+#define PG_ZERO		0x4		/* not present yet, gets a zeroed frame on first touch */
+#define PG_SWAP		(PG_ZERO | PG_OWNED)	/* not present, compressed in swap slot add */
+
 /* Externally-visible functions */
 
-/* enables paging (and PSE extension) */
+/* enables paging (and the PSE and PGE extensions) */
 void pageEnable();
 /* clears pageDir */
 void spawnDir();
@@ -115,6 +199,57 @@ void page_init();
 void chgDir(uint32_t idx, union dirEntry e);
 /* overwrites %cr3 (with same value it had before) to flush the TLB */
 void flushTLB();
+/* invalidates the TLB entry of the page holding addr */
+void flushPage(uint32_t addr);
+
+/* makes PAT entry 1 write-combining on this processor */
+void pat_init();
+/* sets the memory type of the pages of [addr, addr + len) below 4MiB */
+void map_mem_type(uint32_t addr, uint32_t len, uint32_t type);
+/* maps the kernel page at addr read-only for every process at TIME_PAGE_USER */
+void map_time_page(uint32_t addr);
+/* maps the page at addr below 4MiB 1:1 for the kernel, or unmaps it if present is 0 */
+void map_low_page(uint32_t addr, uint32_t present);
+/* takes a free 4KiB frame from the frame pool, 0 if there is none */
+uint32_t alloc_frame();
+/* takes a frame only if one is free, without making room; 0 if there is none */
+uint32_t alloc_free_frame();
+/* records usable memory from the multiboot map, keeps what lies above 4GiB */
+void highmem_add(uint64_t base, uint64_t len);
+/* number of 4MiB chunks above 4GiB nobody uses */
+uint32_t high_avail();
+/* maps a zeroed 4MiB chunk from above 4GiB at vaddr (in the big region) for pid */
+int32_t map_user_big(uint32_t pid, uint32_t vaddr, uint32_t rw);
+/* unmaps one of them, giving its chunk back */
+void unmap_user_big(uint32_t pid, uint32_t vaddr);
+/* number of frames nobody uses */
+uint32_t free_frames();
+/* compresses up to n cold pages of processes that aren't running, returns how many */
+uint32_t swap_out_cold(uint32_t n, uint32_t may_grow);
+/* takes a frame that is already zeroed, from the pre-zeroed pool if it can */
+uint32_t alloc_zeroed_frame();
+/* zeroes up to n frames into the pre-zeroed pool, returns how many */
+uint32_t zero_pool_refill(uint32_t n);
+/* takes another reference to a frame so it can be shared */
+void get_frame(uint32_t addr);
+/* drops a reference to a frame, it goes back to the pool after the last one */
+void free_frame(uint32_t addr);
+/* maps a 4KiB page read-only into the user pages of process pid */
+void map_user_page(uint32_t pid, uint32_t vaddr, uint32_t paddr, uint32_t avl);
+/* gives a user page of pid a zeroed frame (if it has none) and returns it */
+uint32_t map_user_frame(uint32_t pid, uint32_t vaddr, uint32_t rw);
+/* reserves a user page of pid that is zero-filled on first touch */
+void map_user_zero(uint32_t pid, uint32_t vaddr, uint32_t rw);
+/* unmaps one user page of pid, giving its frame back */
+void unmap_user_page(uint32_t pid, uint32_t vaddr);
+/* 1 if the kernel may read (or, with write, write) [addr, addr + len) for pid */
+int32_t user_range_ok(uint32_t pid, uint32_t addr, uint32_t len, uint32_t write);
+/* loads the page directory of process pid into cr3 */
+void user_switch(uint32_t pid);
+/* unmaps everything process pid has mapped */
+void user_release(uint32_t pid);
+/* resolves faults we can fix (copy-on-write, zero-fill), 0 if the fault was handled */
+int32_t page_fault_fixup(uint32_t addr, uint32_t err);
 
 extern void pf_handler_wrapper();
 
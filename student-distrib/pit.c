@@ -5,58 +5,144 @@
 #include "pit.h"
 #include "lib.h"
 #include "i8259.h"
-#include "filesystem.h"
-#include "paging.h"
-#include "x86_desc.h"
 #include "scheduling.h"
+#include "stats.h"
 
+static int32_t pit_probe(void);
+static int32_t pit_event_probe(void);
+static uint64_t pit_read(void);
+static void pit_periodic(void);
+static void pit_oneshot(uint32_t ns);
 
-void pit_init(void) {
-    int divisor = PIT_FREQ / PIT_RATE;      /* Calculate our divisor */
-    outb(PIT_CMD, PIT_CMD_PORT);            /* Set our command byte to 0x36 */
-    outb(divisor & 0xFF, PIT_PORT);         /* Set low byte of divisor */
-    outb(divisor >> 8, PIT_PORT);           /* Set high byte of divisor */
-    enable_irq(PIT_IRQ);                    /* Enable PIT IRQ */
+/* Channel 2 left counting down from 65536 over and over, the clock of
+ * last resort: it wraps every 55ms and reading it takes three port I/Os */
+struct clocksource pit_clocksource = {
+    .name = "pit",
+    .rating = 100,
+    .probe = pit_probe,
+    .read = pit_read,
+    .mask = 0xFFFF,
+    .freq = PIT_FREQ,
+};
+
+/* Channel 0 on IRQ0, as a rate generator or counting down once */
+struct clock_event pit_clock_event = {
+    .name = "pit",
+    .rating = 100,
+    .irq = PIT_IRQ,
+    .max_ns = (uint64_t)PIT_MAX_COUNT * NSEC_PER_SEC / PIT_FREQ,
+    .probe = pit_event_probe,
+    .periodic = pit_periodic,
+    .oneshot = pit_oneshot,
+};
+
+
+/*
+ * pit_load
+ * DESCRIPTION: programs channel 0
+ * INPUTS: cmd - PIT_CMD or PIT_CMD_ONESHOT
+ *         count - input clocks until the output fires
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: restarts the counter
+ */
+static void pit_load(uint8_t cmd, uint32_t count) {
+    outb(cmd, PIT_CMD_PORT);
+    outb(count & 0xFF, PIT_PORT);           /* Set low byte of count */
+    outb(count >> 8, PIT_PORT);             /* Set high byte of count */
+}
+
+
+/*
+ * pit_calibrate
+ * DESCRIPTION: times a counter against PIT channel 2, counting down
+ *              PIT_CAL_COUNT clocks with the speaker off. Takes the
+ *              shortest of a few tries, the others were interrupted.
+ * INPUTS: read - reads the counter
+ * OUTPUTS: none
+ * RETURN VALUE: counts per second, 0 if the counter didn't move
+ * SIDE EFFECTS: uses channel 2; run with interrupts off
+ */
+uint64_t pit_calibrate(uint64_t (*read)(void)) {
+    uint32_t i;
+    uint64_t start, delta, best = 0;
+
+    outb((inb(PIT_GATE_PORT) & ~0x02) | 0x01, PIT_GATE_PORT);
+    for (i = 0; i < PIT_CAL_TRIES; i++) {
+        outb(PIT_CH2_ONESHOT, PIT_CMD_PORT);
+        outb(PIT_CAL_COUNT & 0xFF, PIT_CH2_PORT);
+        outb(PIT_CAL_COUNT >> 8, PIT_CH2_PORT);    /* counts from here */
+        start = read();
+        while (!(inb(PIT_GATE_PORT) & 0x20));       /* OUT2 goes high at 0 */
+        delta = read() - start;
+        if (best == 0 || delta < best)
+            best = delta;
+    }
+    return div_u64(best * PIT_FREQ, PIT_CAL_COUNT);
+}
+
+
+/*
+ * pit_probe
+ * DESCRIPTION: every PC has a PIT. Sets channel 2 running for the clock
+ *              source.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0
+ * SIDE EFFECTS: programs channel 2
+ */
+static int32_t pit_probe(void) {
+    outb((inb(PIT_GATE_PORT) & ~0x02) | 0x01, PIT_GATE_PORT);
+    outb(PIT_CH2_FREE, PIT_CMD_PORT);
+    outb(0, PIT_CH2_PORT);                  /* 0 is 65536 */
+    outb(0, PIT_CH2_PORT);
+    return 0;
 }
 
+static int32_t pit_event_probe(void) {
+    return 0;                               /* channel 0 is left alone until it is picked */
+}
+
+static uint64_t pit_read(void) {
+    uint32_t count;
+
+    outb(PIT_CH2_LATCH, PIT_CMD_PORT);
+    count = inb(PIT_CH2_PORT);
+    count |= inb(PIT_CH2_PORT) << 8;
+    return (0x10000 - count) & 0xFFFF;      /* counts down, the clock counts up */
+}
+
+static void pit_periodic(void) {
+    pit_load(PIT_CMD, PIT_DIVISOR);
+}
+
+static void pit_oneshot(uint32_t ns) {
+    uint32_t count = div_u64((uint64_t)ns * PIT_FREQ, NSEC_PER_SEC);
+
+    if (count == 0)
+        count = 1;
+    if (count > PIT_MAX_COUNT)
+        count = PIT_MAX_COUNT;
+    pit_load(PIT_CMD_ONESHOT, count);
+}
+
+
+/*
+ * pit_handler
+ * DESCRIPTION: Handles IRQ0, raised by channel 0 or by an HPET in legacy
+ *              replacement mode; only unmasked when one of those is the
+ *              clock event device
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: may switch to another process. If the interrupted code
+ *               has preemption disabled the switch waits for its
+ *               preempt_enable instead.
+ */
 void pit_handler(void) {
+    irqoff_begin(__FILE__, __LINE__);       /* came in through an interrupt gate */
     send_eoi(PIT_IRQ);                      /* Send EOI */
-    cli();
-    
-    // task switching steps
-    // 1. save esp and ebp
-    // 2. switch paging, flush tlb
-
-    union dirEntry d;
-    pcb_t* pcb = get_pcb();
-
-    // save esp and ebp
-    asm volatile(
-        "movl %%esp, %0;"
-        "movl %%ebp, %1;"
-        : "=r"(pcb->saved_esp), "=r"(pcb->saved_ebp)
-    );
-
-    // launch two or more shells
-    // maybe call scheduler here?
-
-    pcb = get_pcb();
-
-    d.val = 7;		//sets P and RW bits
-    d.whole.ps = 1;
-	d.whole.add_22_31 = (_8MB + _4MB * pcb->pid) >> 22; //bit shift by 22 to access correct address
-	chgDir(32, d);	//32 = 128 / 4 (all programs are in the 128-132 MiB vmem page
-    flushTLB();
-
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = _8MB - (pcb->pid) * _8KB - 4; //subtract 4 for padding
-
-    asm volatile(
-        "movl %0, %%esp;"
-        "movl %1, %%ebp;"
-        :
-        :"r"(pcb->saved_esp), "r"(pcb->saved_ebp)
-    );
-
-    sti();
+    timer_interrupt();
+    irqoff_end();
+    sched_irq_return();
 }
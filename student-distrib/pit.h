@@ -2,21 +2,31 @@
  * vim:ts=4 sw=4 noexpandtab
  */
 
-#ifndef _TIMER_H
-#define _TIMER_H
+#ifndef _PIT_H
+#define _PIT_H
 
 #include "types.h"
+#include "timer.h"
 
 /* Frequency of the PIT */
 #define PIT_FREQ 1193182
-#define PIT_RATE 20
+#define PIT_DIVISOR (PIT_FREQ / TICK_RATE)  /* input clocks per tick */
+#define PIT_MAX_COUNT 0xFFFF                /* longest one-shot, about 55ms */
+#define PIT_CAL_COUNT (PIT_FREQ / 100)      /* 10ms, to calibrate against */
+#define PIT_CAL_TRIES 3
 
 /* Ports that each PIC sits on */
 #define PIT_PORT 0x40
+#define PIT_CH2_PORT 0x42
 #define PIT_CMD_PORT 0x43
+#define PIT_GATE_PORT 0x61                  /* bit 0 gates channel 2, bit 1 the speaker, bit 5 reads OUT2 */
 
 /* PIT commands */
-#define PIT_CMD 0x36
+#define PIT_CMD 0x34                        /* channel 0, lo/hi byte, mode 2 (rate generator) */
+#define PIT_CMD_ONESHOT 0x30                /* channel 0, lo/hi byte, mode 0 (interrupt on terminal count) */
+#define PIT_CH2_ONESHOT 0xB0                /* channel 2, lo/hi byte, mode 0 */
+#define PIT_CH2_FREE 0xB4                   /* channel 2, lo/hi byte, mode 2 */
+#define PIT_CH2_LATCH 0x80
 
 /* PIT IRQ */
 #define PIT_IRQ 0
@@ -27,7 +37,8 @@
 #define _8KB 0x00002000
 
 /* Externally-visible functions */
-void pit_init(void);
 void pit_handler(void);
+/* counts per second of read, timed over 10ms of PIT channel 2 */
+uint64_t pit_calibrate(uint64_t (*read)(void));
 
-#endif /* _TIMER_H */
+#endif /* _PIT_H */
@@ -4,13 +4,35 @@
 
 #include "rtc.h"
 #include "i8259.h"
+#include "irq.h"
 #include "x86_desc.h"
 #include "lib.h"
+#include "scheduling.h"
+#include "stats.h"
+#include "timer.h"
+#include "hpet.h"
+
+static int32_t rtc_event_probe(void);
+static void rtc_event_periodic(void);
+
+/* Periodic only, at the rate /dev/rtc runs at; the last resort */
+struct clock_event rtc_clock_event = {
+    .name = "rtc",
+    .rating = 50,
+    .irq = RTC_IRQ,
+    .max_ns = 0,
+    .probe = rtc_event_probe,
+    .periodic = rtc_event_periodic,
+    .oneshot = NULL,
+};
 
 /* Local variables */
 volatile int rtc_interrupt_occurred = 0;    // flag for RTC interrupt
 volatile int rtc_counter = 0; // counter for RTC interrupts
 volatile int rtc_max_count = RTC_MAX_FREQ / RTC_BASE_FREQ; // max number of interrupts before RTC interrupt occurs
+static uint64_t rtc_last_tsc = 0;           // time stamp of the previous tick
+static uint32_t rtc_period = 0;             // shortest gap seen between ticks, in cycles
+static uint32_t rtc_users = 0;              // open RTC files, it only ticks while there are some
 
 /* Local functions */
 /* Set the RTC rate to the given frequency */
@@ -26,6 +48,7 @@ int rtc_set_rate(uint32_t freq);
 int rtc_set_rate(uint32_t freq) {
     int rate = 0;
     int i;
+    uint32_t flags;
     for (i = 6; i < 16; i++) {
         if (freq == (32768 >> (i - 1))) {    /* kernel limited to 1024 Hz */
             rate = i;
@@ -37,38 +60,78 @@ int rtc_set_rate(uint32_t freq) {
         return 0;
     
     rate &= 0x0F;                           /* rate must be above 6 and not over 15 */
-    cli();                                  /* disable interrupts */
+    cli_and_save(flags);                    /* disable interrupts */
     outb(RTC_REG_A, RTC_PORT);              /* select register A, and disable NMI */
     char prev = inb(RTC_DATA);              /* read the current value of register A */
     outb(RTC_REG_A, RTC_PORT);              /* reset index to A */
     outb((prev & 0xF0) | rate, RTC_DATA);   /* write the previous value ORed with 0xF0 */
-    sti();                                  /* enable interrupts */
+    restore_flags(flags);                   /* back to whatever the caller had */
+    rtc_period = 0;                         /* the gap between ticks changed */
     return 1;
 }
 
 
+/* rtc_periodic
+ * DESCRIPTION: Turns the RTC's periodic interrupt on or off. Nobody waits
+ *              on the RTC most of the time, and 1024 interrupts a second
+ *              would keep the CPU from sleeping.
+ * INPUTS: on - 1 to turn it on, 0 to turn it off
+ * OUTPUTS: NONE
+ * RETURN VALUE: NONE
+ * SIDE EFFECTS: writes RTC register B, or sets up the HPET when it took
+ *               the RTC's interrupt over
+ */
+static void rtc_periodic(uint32_t on) {
+    uint32_t flags;
+    char prev;
+
+    cli_and_save(flags);
+    rtc_last_tsc = 0;                       /* the gap across a stop is no latency */
+    if (hpet_legacy()) {
+        hpet_rtc_periodic(on);
+        restore_flags(flags);
+        return;
+    }
+    outb(RTC_REG_B, RTC_PORT);              /* select register B, and disable NMI */
+    prev = inb(RTC_DATA);
+    outb(RTC_REG_B, RTC_PORT);
+    outb(on ? (prev | 0x40) : (prev & ~0x40), RTC_DATA);
+    outb(RTC_REG_C, RTC_PORT);              /* drop a pending interrupt so the next one comes */
+    inb(RTC_DATA);
+    restore_flags(flags);
+}
+
+static int32_t rtc_event_probe(void) {
+    return 0;
+}
+
+static void rtc_event_periodic(void) {
+    rtc_periodic(1);                        /* and rtc_close leaves it on */
+}
+
+
 /*
  * rtc_init
  * DESCRIPTION: Initializes the RTC
  * INPUTS: none
  * OUTPUTS: none
  * RETURN VALUE: none
- * SIDE EFFECTS: Enables the RTC, sets the frequency to the 1024 Hz
+ * SIDE EFFECTS: Sets the frequency to the 1024 Hz, the RTC starts ticking
+ *               when it is first opened
  */
 void rtc_init(void) {
-    cli();                              /* disable interrupts */
-    outb(RTC_REG_B, RTC_PORT);          /* select register B, and disable NMI */
-    char prev = inb(RTC_DATA);          /* read the current value of register B */
-    outb(RTC_REG_B, RTC_PORT);          /* set the index again (a read will reset the index to register D) */
-    outb(prev | 0x40, RTC_DATA);        /* write the previous value ORed with 0x40 */
+    uint32_t flags;
+
+    cli_and_save(flags);                /* disable interrupts */
     #if RTC_VT_EN
     rtc_max_count = RTC_MAX_FREQ / RTC_BASE_FREQ;   /* set the max count to the default frequency */
     rtc_set_rate(RTC_MAX_FREQ);         /* set the frequency to 1024 Hz */
     #else
     rtc_set_rate(RTC_BASE_FREQ);        /* set the frequency to 2 Hz */
     #endif
+    irq_register(IRQ_ISA_VECTOR(RTC_IRQ), rtc_handler, "rtc");
     enable_irq(RTC_IRQ);                /* enable interrupts */
-    sti();
+    restore_flags(flags);
 }
 
 
@@ -84,8 +147,7 @@ int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes) {
     if (buf == NULL)
         return -1;                          /* if the buffer is NULL, the call returns -1 */
 
-    sti();
-    while (!rtc_interrupt_occurred);        /* while the status is open, wait */
+    sched_wait(&rtc_interrupt_occurred);    /* while the status is open, let others run */
     rtc_interrupt_occurred = 0;             /* set the status to open */
     return 0;
 }
@@ -104,15 +166,16 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes) {
         return -1;                          /* if the buffer is NULL, or not a 4-byte value, the call returns -1 */
 
     uint32_t freq = *(uint32_t*)buf;
+    uint32_t flags;
 
     if (!(freq >= 2 && freq <= 1024 && ((freq - 1) & freq) == 0))
         return -1;
 
     #if RTC_VT_EN
-    cli();
+    cli_and_save(flags);
     rtc_max_count = RTC_MAX_FREQ / freq;    /* set the max count to the requested frequency */
     rtc_counter = 0;
-    sti();
+    restore_flags(flags);
     #else
     rtc_set_rate(freq);
     #endif
@@ -138,6 +201,8 @@ int32_t rtc_open(const uint8_t* filename) {
     #else
     rtc_set_rate(RTC_BASE_FREQ);                        /* set the frequency to 2 Hz */
     #endif
+    if (rtc_users++ == 0)
+        rtc_periodic(1);                                /* first user, start ticking */
     return 0;
 }
 
@@ -155,10 +220,38 @@ int32_t rtc_close(int32_t fd) {
         return -1;                          /* trying to close an invalid descriptor returns -1 */
 
     rtc_interrupt_occurred = 1;             /* set the status to closed */
+    if (rtc_users > 0 && --rtc_users == 0 && clock_event != &rtc_clock_event)
+        rtc_periodic(0);                    /* last user gone, stop ticking */
     return 0;
 }
 
 
+/*
+ * rtc_latency
+ * DESCRIPTION: The RTC ticks at a fixed rate, so a tick that arrives
+ *              later than the shortest gap seen between ticks was held
+ *              up by code running with interrupts disabled. Keeps the
+ *              worst such delay as the interrupt latency.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: updates kstats.irq_lat_max and kstats.irq_lat_samples
+ */
+static void rtc_latency(void) {
+    uint64_t now = rdtsc();
+    uint32_t gap = (uint32_t)(now - rtc_last_tsc);
+
+    if (rtc_last_tsc != 0) {
+        if (rtc_period == 0 || gap < rtc_period)
+            rtc_period = gap;
+        if (gap - rtc_period > kstats.irq_lat_max)
+            kstats.irq_lat_max = gap - rtc_period;
+        kstats.irq_lat_samples++;
+    }
+    rtc_last_tsc = now;
+}
+
+
 /*
  * rtc_handler
  * DESCRIPTION: Handles the RTC interrupt
@@ -168,21 +261,31 @@ int32_t rtc_close(int32_t fd) {
  * SIDE EFFECTS: Sends an EOI to the RTC
  */
 void rtc_handler(void) {
-    cli();                                  /* disable interrupts */
+    /* runs through an interrupt gate, so interrupts are already off */
+    irqoff_begin(__FILE__, __LINE__);
+    kstats.rtc_irqs++;
+    rtc_latency();
+    if (hpet_legacy())
+        hpet_rtc_ack();
+    if (clock_event == &rtc_clock_event)
+        timer_interrupt();
 
     #if RTC_VT_EN
     rtc_counter++;                          /* increment the counter */
     if (rtc_counter >= rtc_max_count) {     /* if the counter reaches the max count */
         rtc_interrupt_occurred = 1;         /* set the status to closed */
         rtc_counter = 0;                    /* reset the counter */
+        sched_wake(&rtc_interrupt_occurred);
     }
     #else
     rtc_interrupt_occurred = 1;             /* set the status to closed */
+    sched_wake(&rtc_interrupt_occurred);
     #endif
 
     outb(RTC_REG_C, RTC_PORT);              /* select register C */
     inb(RTC_DATA);                          /* just throw away contents */
 
     send_eoi(RTC_IRQ);                      /* send EOI */
-    sti();                                  /* enable interrupts */
+    irqoff_end();
+    sched_irq_return();
 }
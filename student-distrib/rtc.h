@@ -43,8 +43,6 @@ int32_t rtc_open(const uint8_t* filename);
 int32_t rtc_close(int32_t fd);
 /* RTC interrupt handler */
 extern void rtc_handler(void);
-/* Wrapper function for RTC handler */
-extern void rtc_handler_wrapper();
 
 extern int interrupt_count;
 extern int i_rtc;
@@ -3,17 +3,587 @@
  */
 
 #include "scheduling.h"
+#include "spinlock.h"
+#include "paging.h"
+#include "swap.h"
+#include "stats.h"
+#include "syscall.h"
+#include "x86_desc.h"
+#include "lib.h"
+#include "timer.h"
 
 /* Local variables */
-// volatile int32_t current_terminal;
-// volatile int32_t current_process;
-// volatile int32_t current_process_pid[3] = {0};
-
-
-// void scheduling_init(void) {
-//     current_terminal = 0;
-//     current_process = 0;
-//     current_process_pid[0] = 0;
-//     current_process_pid[1] = 0;
-//     current_process_pid[2] = 0;
-// }
+// process running on each terminal, the end of its execute chain (-1 if none);
+// only these can run, their parents are waiting in execute
+static int32_t term_pid[NUM_TERMS] = {-1, -1, -1};
+// 1 once the shell of a terminal was started
+static uint32_t term_started[NUM_TERMS] = {1, 0, 0};
+// ticks since everyone was last put back on level 0
+static uint32_t boost_ticks = 0;
+// the run queues, the terminal chains above and each process's state,
+// level and processor; taken inside the kernel lock, interrupts off
+static spinlock_t sched_lock = SPINLOCK_INIT;
+
+
+/*
+ * kernel_idle
+ * DESCRIPTION: called over and over by code that busy-waits for an
+ *              interrupt (terminal and RTC reads); uses the time to swap
+ *              out cold pages when memory is low, or else to zero frames
+ *              for the pre-zeroed pool
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: how much it did, 0 if there was nothing left to do
+ * SIDE EFFECTS: may compress pages of waiting processes, may take free
+ *               frames into the pre-zeroed pool; lets go of the kernel
+ *               lock while zeroing
+ */
+uint32_t kernel_idle(void) {
+    uint32_t done, flags;
+    int32_t held;
+
+    preempt_disable();
+    if (free_frames() < SWAP_LOW_WATER) {
+        done = swap_out_cold(SWAP_BATCH, 1);
+    } else {
+        /* zeroing only needs the frame lock: the kernel is free meanwhile */
+        cli_and_save(flags);
+        held = kernel_release();
+        restore_flags(flags);
+        done = zero_pool_refill(ZERO_BATCH);
+        cli_and_save(flags);
+        if (held)
+            (void)kernel_enter();
+        restore_flags(flags);
+    }
+    preempt_enable();
+    if (done == 0)
+        asm volatile ("pause");         /* nothing to do, go easy on the spin */
+    return done;
+}
+
+
+/*
+ * preempt_schedule
+ * DESCRIPTION: called when preemption comes back on (or at a preemption
+ *              point) after the timer asked for a switch while it was off.
+ *              Only switches with interrupts enabled, never from inside a
+ *              handler or cli section that runs with them off.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: may switch processes
+ */
+void preempt_schedule(void) {
+    uint32_t flags;
+
+    asm volatile ("pushfl; popl %0" : "=r"(flags));
+    if (!(flags & 0x200) || preempt_count != 0)
+        return;                         /* left set for the next preemption point */
+    kstats.preempt_deferred++;
+    schedule();
+}
+
+
+/*
+ * sched_lock_irqsave
+ * DESCRIPTION: takes sched_lock with this processor's interrupts off, so
+ *              none of its handlers can try to take it again
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the flags to give sched_unlock_irqrestore
+ * SIDE EFFECTS: waits for other processors to let go of it
+ */
+static uint32_t sched_lock_irqsave(void) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    spin_lock(&sched_lock);
+    return flags;
+}
+
+static void sched_unlock_irqrestore(uint32_t flags) {
+    spin_unlock(&sched_lock);
+    restore_flags(flags);
+}
+
+
+/*
+ * sched_move
+ * DESCRIPTION: puts p on processor cpu's run queue, off any other one
+ * INPUTS: p - process, cpu - processor number
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: sched_lock must be held
+ */
+static void sched_move(pcb_t* p, uint32_t cpu) {
+    uint32_t c;
+
+    for (c = 0; c < MAX_CPUS; c++)
+        cpus[c].runq &= ~(1 << p->pid);
+    cpus[cpu].runq |= 1 << p->pid;
+    p->cpu = cpu;
+}
+
+
+/*
+ * sched_runnable
+ * DESCRIPTION: whether p can be given the CPU
+ * INPUTS: p - process
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if p is alive, ready and the last of its terminal's chain
+ * SIDE EFFECTS: none
+ */
+static int32_t sched_runnable(pcb_t* p) {
+    return p->active && p->state == TASK_READY && term_pid[p->term] == (int32_t)p->pid;
+}
+
+
+/*
+ * sched_on_cpu
+ * DESCRIPTION: whether a processor is running pid: executing its code,
+ *              or idling in its schedule. Such a process can't be picked
+ *              by any other processor and its TLB entries may be live.
+ * INPUTS: pid - process
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if one is, 0 if not
+ * SIDE EFFECTS: none
+ */
+int32_t sched_on_cpu(uint32_t pid) {
+    uint32_t c;
+
+    for (c = 0; c < MAX_CPUS; c++) {
+        if (cpus[c].online && cpus[c].curr == (int32_t)pid)
+            return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * sched_set_current
+ * DESCRIPTION: called wherever this processor starts running pid on its
+ *              kernel stack: a switch, execute and halt. The process
+ *              moves to this processor's run queue.
+ * INPUTS: pid - process
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: entries from user mode land on pid's kernel stack
+ */
+void sched_set_current(uint32_t pid) {
+    struct cpu* c = smp_cpu();
+    uint32_t flags = sched_lock_irqsave();
+
+    c->curr = pid;
+    sched_move(curr_pcb[pid], smp_id());
+    sched_unlock_irqrestore(flags);
+    c->tss->ss0 = KERNEL_DS;
+    c->tss->esp0 = _8MB - pid * _8KB - 4;
+}
+
+
+/*
+ * sched_count
+ * DESCRIPTION: how many processes could be given the CPU
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: the number of runnable processes
+ * SIDE EFFECTS: none
+ */
+static uint32_t sched_count(void) {
+    uint32_t i, n = 0;
+    uint32_t flags = sched_lock_irqsave();
+
+    for (i = 0; i < MAX_PROCESSES; i++)
+        n += sched_runnable(curr_pcb[i]);
+    sched_unlock_irqrestore(flags);
+    return n;
+}
+
+
+/*
+ * sched_waiting
+ * DESCRIPTION: whether p is on processor cpu's run queue and could be
+ *              switched to: runnable and not on any processor
+ * INPUTS: p - process, cpu - processor number
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if so
+ * SIDE EFFECTS: none
+ */
+static int32_t sched_waiting(pcb_t* p, uint32_t cpu) {
+    return (cpus[cpu].runq & (1 << p->pid)) && sched_runnable(p) && !sched_on_cpu(p->pid);
+}
+
+
+/*
+ * sched_steal
+ * DESCRIPTION: work stealing for a processor with nothing of its own to
+ *              run: takes the best waiting process from the processor with
+ *              the most of them
+ * INPUTS: me - the idle processor
+ * OUTPUTS: none
+ * RETURN VALUE: the process, now on me's run queue, NULL if there is none
+ * SIDE EFFECTS: sched_lock must be held
+ */
+static pcb_t* sched_steal(uint32_t me) {
+    uint32_t c, i, level, n, most = 0, victim = 0;
+    pcb_t* p;
+
+    for (c = 0; c < MAX_CPUS; c++) {
+        if (c == me || !cpus[c].online)
+            continue;
+        for (n = 0, i = 0; i < MAX_PROCESSES; i++)
+            n += sched_waiting(curr_pcb[i], c);
+        if (n > most) {
+            most = n;
+            victim = c;
+        }
+    }
+    if (most == 0)
+        return NULL;
+
+    for (level = 0; level < SCHED_LEVELS; level++) {
+        for (i = 0; i < MAX_PROCESSES; i++) {
+            p = curr_pcb[i];
+            if (sched_waiting(p, victim) && p->level == level) {
+                sched_move(p, me);
+                kstats.sched_steals++;
+                return p;
+            }
+        }
+    }
+    return NULL;
+}
+
+
+/*
+ * sched_pick
+ * DESCRIPTION: finds the process to run next: the first runnable one on
+ *              the lowest level of this processor's queue, starting after
+ *              cur so that processes on the same level take turns. An
+ *              empty queue steals from another processor.
+ * INPUTS: cur - the running process, NULL on a processor that has none
+ * OUTPUTS: none
+ * RETURN VALUE: the process, NULL if none is runnable
+ * SIDE EFFECTS: may move a process to this processor's queue
+ */
+static pcb_t* sched_pick(pcb_t* cur) {
+    uint32_t level, i, me = smp_id();
+    uint32_t start = (cur != NULL) ? cur->pid : MAX_PROCESSES - 1;
+    uint32_t flags = sched_lock_irqsave();
+    pcb_t* p;
+
+    for (level = 0; level < SCHED_LEVELS; level++) {
+        for (i = 1; i <= MAX_PROCESSES; i++) {
+            p = curr_pcb[(start + i) % MAX_PROCESSES];
+            if (p->level == level && (p == cur ? sched_runnable(p) : sched_waiting(p, me)))
+                goto found;
+        }
+    }
+    p = sched_steal(me);
+found:
+    sched_unlock_irqrestore(flags);
+    return p;
+}
+
+
+/*
+ * sched_switch
+ * DESCRIPTION: continues next where it was switched away from. The
+ *              kernel lock stays with this processor, so no other one can
+ *              pick the process it leaves before its context is saved.
+ * INPUTS: next - process with a saved context
+ * OUTPUTS: none
+ * RETURN VALUE: never returns
+ * SIDE EFFECTS: switches address space, kernel stack and terminal
+ */
+static void sched_switch(pcb_t* next) __attribute__((noreturn));
+static void sched_switch(pcb_t* next) {
+    kstats.ctx_switches++;
+    sched_set_current(next->pid);
+    user_switch(next->pid);
+    select_term(next->term);
+    irqoff_end();                       /* next closes its own window, if any */
+    sched_resume(&next->ctx);
+}
+
+
+/*
+ * sched_spawn
+ * DESCRIPTION: starts the shell of the first terminal that doesn't have
+ *              one yet. The shell is executed from cur's kernel stack,
+ *              which is left alone above the saved context, and cur
+ *              continues from here when it is next picked.
+ * INPUTS: cur - the running process
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: may switch to a new shell; interrupts must be off
+ */
+static void sched_spawn(pcb_t* cur) {
+    uint32_t t, flags;
+
+    for (t = 0; t < NUM_TERMS; t++) {
+        flags = sched_lock_irqsave();
+        if (term_started[t]) {
+            sched_unlock_irqrestore(flags);
+            continue;
+        }
+        term_started[t] = 1;
+        sched_unlock_irqrestore(flags);
+        if (sched_save(&cur->ctx) == 0 && process_execute((uint8_t*)"shell", -1, t) == -1)
+            sched_restart_term(t);  /* execute failed, try again later */
+        return;     /* switched back, or execute failed and we keep running */
+    }
+}
+
+
+/*
+ * schedule
+ * DESCRIPTION: gives the CPU to the best ready process. When nothing is
+ *              ready (every process is waiting for input) it does idle
+ *              work with interrupts on, and once that runs out halts
+ *              until an interrupt wakes something up. The timer only
+ *              ticks periodically while processes compete for the CPU.
+ *              A TASK_DEAD process is never switched back to: it idles
+ *              here on its kernel stack until something else can run.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none, and never for a TASK_DEAD process
+ * SIDE EFFECTS: switches address space, kernel stack and terminal.
+ *               While halted the processor gives up the kernel lock.
+ */
+void schedule(void) {
+    pcb_t* cur = get_pcb();
+    pcb_t* next;
+    uint32_t flags, done, me = smp_id();
+
+    need_resched = 0;
+    if (cur == NULL || (!cur->active && cur->state != TASK_DEAD))
+        return;                         /* not in a process yet */
+    cli_and_save(flags);
+
+    while (1) {
+        if (me == 0)
+            sched_spawn(cur);
+        if ((next = sched_pick(cur)) != NULL)
+            break;
+        preempt_count++;                /* handlers must not switch in here */
+        if (me == 0)
+            tick_update(0);
+        sti();
+        done = kernel_idle();
+        cli();
+        if (done == 0 && sched_pick(cur) == NULL) {
+            irqoff_end();
+            kernel_exit(1);
+            asm volatile ("sti; hlt");  /* sti holds interrupts off until hlt */
+            cli();
+            (void)kernel_enter();
+        }
+        preempt_count--;
+    }
+    if (me == 0)
+        tick_update(sched_count());
+
+    if (next != cur && (cur->state == TASK_DEAD || sched_save(&cur->ctx) == 0))
+        sched_switch(next);
+    restore_flags(flags);
+}
+
+
+/*
+ * sched_start_cpu
+ * DESCRIPTION: the scheduler of a processor that just came online, with
+ *              interrupts off and the kernel lock held. It has no process
+ *              of its own, so it waits for one to steal, halting between
+ *              its ticks, and switches to it. From then on it idles in
+ *              the schedule of whatever process it runs, like the boot
+ *              processor.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: never returns
+ * SIDE EFFECTS: leaves its boot stack behind for good
+ */
+void sched_start_cpu(void) {
+    pcb_t* next;
+
+    while ((next = sched_pick(NULL)) == NULL) {
+        kernel_exit(1);
+        asm volatile ("sti; hlt");
+        cli();
+        (void)kernel_enter();
+    }
+    sched_switch(next);
+}
+
+
+/*
+ * sched_tick
+ * DESCRIPTION: called on every timer interrupt. Charges the ticks to the
+ *              running process, moving it down a level when its quantum
+ *              is used up, and every SCHED_BOOST ticks puts every process
+ *              back on the top level it may use so none of them starves.
+ * INPUTS: ticks - ticks since the last call, more than 1 after a one-shot
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: sets need_resched when another process should get a turn
+ */
+void sched_tick(uint32_t ticks) {
+    pcb_t* cur = get_pcb();
+    uint32_t i, flags;
+
+    if (term_pid[0] < 0 && term_started[0])
+        return;                         /* the first shell isn't up yet */
+    flags = sched_lock_irqsave();
+
+    /* the boot processor keeps the time for everyone */
+    if (smp_id() == 0 && (boost_ticks += ticks) >= SCHED_BOOST) {
+        boost_ticks = 0;
+        for (i = 0; i < MAX_PROCESSES; i++) {
+            curr_pcb[i]->level = NICE_LEVEL(curr_pcb[i]->nice);
+            curr_pcb[i]->slice = 0;
+        }
+        kstats.sched_boosts++;
+        need_resched = 1;
+    }
+
+    if (cur != NULL && cur->active && cur->state == TASK_READY &&
+            (cur->slice += ticks) >= SCHED_QUANTUM(cur->level)) {
+        cur->slice = 0;
+        if (cur->level < SCHED_LEVELS - 1) {
+            cur->level++;
+            kstats.sched_demotions++;
+        }
+        need_resched = 1;
+    }
+
+    for (i = 0; i < NUM_TERMS; i++) {
+        if (!term_started[i] && smp_id() == 0)
+            need_resched = 1;
+    }
+    sched_unlock_irqrestore(flags);
+}
+
+
+/*
+ * sched_irq_return
+ * DESCRIPTION: called at the end of interrupt handlers, after the EOI.
+ *              Switches right away if a wakeup or the timer asked for it,
+ *              unless the interrupted code has preemption disabled.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: may switch processes
+ */
+void sched_irq_return(void) {
+    if (need_resched && preempt_count == 0)
+        schedule();
+}
+
+
+/*
+ * sched_wait
+ * DESCRIPTION: blocks the current process until an interrupt handler sets
+ *              *flag and calls sched_wake on it. Outside of any process
+ *              (kernel tests) it just spins with kernel_idle.
+ * INPUTS: flag - what to wait for
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: runs other processes in the meantime
+ */
+void sched_wait(volatile int32_t* flag) {
+    pcb_t* cur = get_pcb();
+    uint32_t flags;
+
+    if (cur == NULL || !cur->active) {
+        while (!*flag)
+            kernel_idle();
+        return;
+    }
+    cli_and_save(flags);                /* so the wakeup can't slip in between */
+    while (!*flag) {
+        cur->wait = flag;
+        cur->state = TASK_BLOCKED;
+        schedule();
+    }
+    restore_flags(flags);
+}
+
+
+/*
+ * sched_wake
+ * DESCRIPTION: readies every process blocked on flag and moves it to the
+ *              top level it may use: it waited for input, so it is
+ *              interactive and should answer quickly
+ * INPUTS: flag - what they wait for
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: sets need_resched of the processor whose queue it is on,
+ *               interrupting it if it isn't this one
+ */
+void sched_wake(volatile int32_t* flag) {
+    uint32_t i, flags = sched_lock_irqsave();
+    pcb_t* p;
+
+    for (i = 0; i < MAX_PROCESSES; i++) {
+        p = curr_pcb[i];
+        if (p->active && p->state == TASK_BLOCKED && p->wait == flag) {
+            p->state = TASK_READY;
+            p->level = NICE_LEVEL(p->nice);
+            p->slice = 0;
+            kstats.sched_wakeups++;
+            cpus[p->cpu].resched = 1;
+            smp_resched(p->cpu);
+        }
+    }
+    sched_unlock_irqrestore(flags);
+}
+
+
+/*
+ * sched_set_leaf
+ * DESCRIPTION: execute and halt call this to record which process of a
+ *              terminal's chain is the one that runs
+ * INPUTS: term - terminal, pid - the process, -1 for none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void sched_set_leaf(uint32_t term, int32_t pid) {
+    uint32_t flags = sched_lock_irqsave();
+
+    term_pid[term] = pid;
+    sched_unlock_irqrestore(flags);
+}
+
+
+/*
+ * sched_restart_term
+ * DESCRIPTION: halt calls this when the shell of a terminal couldn't be
+ *              started again, so the boot processor retries it whenever
+ *              it schedules
+ * INPUTS: term - terminal
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void sched_restart_term(uint32_t term) {
+    uint32_t flags = sched_lock_irqsave();
+
+    term_started[term] = 0;
+    sched_unlock_irqrestore(flags);
+}
+
+
+/*
+ * current_term
+ * DESCRIPTION: terminal the running process reads from and writes to
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: its terminal, 0 when not in a process
+ * SIDE EFFECTS: none
+ */
+uint32_t current_term(void) {
+    pcb_t* p = get_pcb();
+    return (p != NULL && p->active) ? p->term : 0;
+}
@@ -6,14 +6,96 @@
 #define _SCHEDULING_H
 
 #include "types.h"
+#include "smp.h"
 
-// /* Externally visible variables */
-// extern int32_t current_terminal;    // current display
-// extern int32_t current_process;
-// extern int32_t current_process_pid[3];
+/* Multilevel feedback queue: a process starts at level 0, drops a level
+ * each time it uses up its quantum and goes back up when it wakes from a
+ * terminal or RTC read, so interactive programs run ahead of CPU hogs.
+ * Every processor has a run queue of its own, the processes whose cpu
+ * is that processor; one that runs out of work steals a waiting process
+ * from the busiest other queue. */
+#define SCHED_LEVELS 3
+#define SCHED_QUANTUM(level) (1 << (level))     /* in timer ticks */
+#define SCHED_BOOST 100         /* ticks between putting everyone back on top */
+#define NICE_MAX 19
+#define NICE_LEVEL(nice) ((nice) * SCHED_LEVELS / (NICE_MAX + 1))   /* highest level nice allows */
 
-// /* Externally visible functions */
-// void scheduling_init(void);
+/* Process states */
+#define TASK_READY 0            /* running or waiting for the CPU */
+#define TASK_BLOCKED 1          /* waiting on pcb->wait */
+#define TASK_DEAD 2             /* halted with nobody to return to, on its way out */
+
+/* Registers kept across a switch, filled by sched_save */
+struct sched_ctx {
+    uint32_t ebx;
+    uint32_t esi;
+    uint32_t edi;
+    uint32_t ebp;
+    uint32_t esp;
+    uint32_t eip;
+};
+
+/* Per-processor variables */
+/* nesting depth of preempt_disable; the kernel may only switch away at 0 */
+#define preempt_count (smp_cpu()->preempt)
+/* set by the timer when it wanted to switch but preemption was disabled */
+#define need_resched (smp_cpu()->resched)
+
+/* Externally visible functions */
+/* does background work while the kernel waits for an interrupt */
+uint32_t kernel_idle(void);
+/* runs a reschedule the timer had to put off */
+void preempt_schedule(void);
+/* saves the caller's registers; returns 0, then 1 when switched back to */
+int32_t sched_save(struct sched_ctx* ctx) __attribute__((returns_twice));
+/* continues a context saved by sched_save, never returns */
+void sched_resume(struct sched_ctx* ctx) __attribute__((noreturn));
+/* gives the CPU to the best ready process, if it isn't the current one */
+void schedule(void);
+/* runs the scheduler of a processor that just came up, never returns */
+void sched_start_cpu(void) __attribute__((noreturn));
+/* 1 if some processor is running process pid */
+int32_t sched_on_cpu(uint32_t pid);
+/* records that this processor now runs process pid */
+void sched_set_current(uint32_t pid);
+/* timer tick accounting, asks for a reschedule when a quantum runs out */
+void sched_tick(uint32_t ticks);
+/* called last in interrupt handlers, switches if a wakeup asked for it */
+void sched_irq_return(void);
+/* blocks the current process until *flag is non-zero */
+void sched_wait(volatile int32_t* flag);
+/* makes the processes waiting on flag ready, at the top of the queue */
+void sched_wake(volatile int32_t* flag);
+/* records pid (or -1) as the process running on terminal term */
+void sched_set_leaf(uint32_t term, int32_t pid);
+/* has the scheduler start the shell of terminal term again */
+void sched_restart_term(uint32_t term);
+/* terminal of the running process, 0 outside of any process */
+uint32_t current_term(void);
+
+/* Keeps the current process on the CPU until the matching preempt_enable.
+ * Unlike cli, interrupts still come in; only switching away is held off,
+ * so long paths can hold it without delaying the keyboard or the timer */
+#define preempt_disable()               \
+do {                                    \
+    preempt_count++;                    \
+    asm volatile ("" : : : "memory");   \
+} while (0)
+
+/* Undoes one preempt_disable, running a deferred reschedule at depth 0 */
+#define preempt_enable()                \
+do {                                    \
+    asm volatile ("" : : : "memory");   \
+    if (--preempt_count == 0 && need_resched) \
+        preempt_schedule();             \
+} while (0)
+
+/* Preemption point for long loops that run with preemption enabled */
+#define cond_resched()                  \
+do {                                    \
+    if (need_resched && preempt_count == 0) \
+        preempt_schedule();             \
+} while (0)
 
 
 #endif /* _SCHEDULING_H */
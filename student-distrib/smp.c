@@ -0,0 +1,261 @@
+/* smp.c - Starting the other processors, and the kernel lock
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#include "smp.h"
+#include "spinlock.h"
+#include "lapic.h"
+#include "timer.h"
+#include "paging.h"
+#include "scheduling.h"
+#include "stats.h"
+#include "acpi.h"
+#include "irq.h"
+#include "lib.h"
+
+/* Externally visible variables */
+struct cpu cpus[MAX_CPUS] = {
+    { .online = 1, .curr = -1, .tss = &tss },
+};
+uint32_t smp_cpus = 1;
+// boot and idle stacks of the other processors, found by ap_start32
+uint8_t ap_stacks[MAX_CPUS - 1][AP_STACK_SIZE] __attribute__((aligned(AP_STACK_SIZE)));
+
+/* Local variables */
+// System calls, faults and interrupt handlers run under this lock: a
+// processor holds it from its entry into the kernel (from user mode or a
+// halted processor) until it returns to user mode or halts for lack of
+// work. The boot processor holds it from the start. The frame pool
+// (frame_lock in paging.c) and the run queues (sched_lock in
+// scheduling.c) have locks of their own, taken inside this one, so code
+// that only needs those, like zeroing frames while idle, runs without it.
+static spinlock_t kernel_lock = { 1 };
+static volatile int32_t kernel_lock_owner = 0;
+// the TSS of each other processor
+static tss_t ap_tss[MAX_CPUS - 1];
+// set once smp_init stopped waiting; processors that show up later stay out
+static spinlock_t smp_boot_lock = SPINLOCK_INIT;
+static uint32_t smp_booted = 0;
+
+
+/*
+ * kernel_enter
+ * DESCRIPTION: called with interrupts off on every way into the kernel
+ *              that can come from user mode or from a halted processor.
+ *              Nested entries on a processor that already holds the lock
+ *              leave it alone. The selected terminal is global, so it is
+ *              set back to the running process's.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if it took the lock, to be passed to kernel_exit
+ * SIDE EFFECTS: waits for the other processors to leave the kernel
+ */
+int32_t kernel_enter(void) {
+    uint32_t id = smp_id();
+
+    if (kernel_lock_owner == (int32_t)id)
+        return 0;
+    if (!spin_trylock(&kernel_lock)) {
+        spin_lock(&kernel_lock);
+        kstats.kernel_lock_waits++;
+    }
+    kernel_lock_owner = id;
+    select_term(current_term());
+    return 1;
+}
+
+/*
+ * kernel_exit
+ * DESCRIPTION: undoes kernel_enter, right before returning to user mode
+ *              or halting
+ * INPUTS: took - what kernel_enter returned
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: interrupts must be off
+ */
+void kernel_exit(int32_t took) {
+    if (!took)
+        return;
+    kernel_lock_owner = -1;
+    spin_unlock(&kernel_lock);
+}
+
+
+/*
+ * kernel_release
+ * DESCRIPTION: gives up the kernel lock for work that only touches data
+ *              with a lock of its own; kernel_enter takes it back
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if this processor held it and has to kernel_enter
+ *               again, 0 if it didn't
+ * SIDE EFFECTS: interrupts must be off
+ */
+int32_t kernel_release(void) {
+    if (kernel_lock_owner != (int32_t)smp_id())
+        return 0;
+    kernel_exit(1);
+    return 1;
+}
+
+
+/*
+ * smp_resched
+ * DESCRIPTION: interrupts processor cpu so it runs its scheduler, after
+ *              its need_resched was set
+ * INPUTS: cpu - processor number
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: nothing if it is this processor or isn't online
+ */
+void smp_resched(uint32_t cpu) {
+    uint32_t flags;
+
+    if (cpu == smp_id() || !cpus[cpu].online)
+        return;
+    cli_and_save(flags);
+    lapic_ipi(cpus[cpu].apic_id, LAPIC_ICR_ASSERT | LAPIC_ICR_FIXED | LAPIC_RESCHED_VECTOR);
+    restore_flags(flags);
+}
+
+
+/*
+ * smp_tss_desc
+ * DESCRIPTION: fills in the GDT entry of the TSS of processor id, set up
+ *              the way entry() sets up the boot processor's
+ * INPUTS: id - 1 and up
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+static void smp_tss_desc(uint32_t id) {
+    seg_desc_t desc;
+    tss_t* t = &ap_tss[id - 1];
+
+    desc.val[0] = desc.val[1] = 0;
+    desc.present = 1;
+    desc.type = 0x9;
+    desc.seg_lim_19_16 = TSS_SIZE & 0x000F0000;
+    desc.seg_lim_15_00 = TSS_SIZE & 0x0000FFFF;
+    SET_TSS_PARAMS(desc, t, tss_size);
+    ap_tss_desc_ptr[id - 1] = desc;
+
+    t->ldt_segment_selector = KERNEL_LDT;
+    t->ss0 = KERNEL_DS;
+    cpus[id].tss = t;
+    cpus[id].curr = -1;
+}
+
+static void smp_delay(uint32_t ns) {
+    uint64_t start = clock_ns();
+
+    while (clock_ns() - start < ns)
+        asm volatile ("pause");
+}
+
+/*
+ * smp_wake
+ * DESCRIPTION: INIT and two startup IPIs, to one processor or with a
+ *              shorthand
+ * INPUTS: apic_id - destination, shorthand - 0 or LAPIC_ICR_OTHERS
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: interrupts must be off
+ */
+static void smp_wake(uint32_t apic_id, uint32_t shorthand) {
+    uint32_t i;
+
+    lapic_ipi(apic_id, shorthand | LAPIC_ICR_ASSERT | LAPIC_ICR_INIT);
+    smp_delay(AP_INIT_NS);
+    for (i = 0; i < 2; i++) {
+        lapic_ipi(apic_id, shorthand | LAPIC_ICR_ASSERT | LAPIC_ICR_STARTUP | (AP_TRAMPOLINE >> 12));
+        smp_delay(AP_SIPI_NS);
+    }
+}
+
+
+/*
+ * smp_init
+ * DESCRIPTION: wakes the other processors the MADT lists with INIT and
+ *              two startup IPIs each, or all at once with a broadcast if
+ *              there is no MADT, and gives them AP_WAIT_NS to come online. They
+ *              start in the trampoline, copied to AP_TRAMPOLINE below
+ *              1MiB, and switch to protected mode and the kernel's page
+ *              directory from there.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: sets smp_cpus. Needs the clock, and the local APIC timer
+ *               calibrated to tick the others; without it they stay off.
+ */
+void smp_init(void) {
+    uint32_t i, flags;
+
+    cpus[0].apic_id = lapic_id();
+    kstats.cpus = smp_cpus;
+    if (!lapic_timer_ok())
+        return;
+    irq_register(LAPIC_RESCHED_VECTOR, lapic_resched_handler, "resched");
+    for (i = 1; i < MAX_CPUS; i++)
+        smp_tss_desc(i);
+    asm volatile ("movl %%cr3, %0" : "=r"(ap_cr3));
+    asm volatile ("movl %%cr4, %0" : "=r"(ap_cr4));
+    map_low_page(AP_TRAMPOLINE, 1);
+    memcpy((void*)AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+    memcpy((void*)(AP_TRAMPOLINE + (ap_gdtr - ap_trampoline)), &gdt_desc, 6);
+
+    cli_and_save(flags);
+    if (!acpi_madt.found) {
+        smp_wake(0, LAPIC_ICR_OTHERS);
+    } else {
+        for (i = 0; i < acpi_madt.ncpus; i++) {
+            if (acpi_madt.cpu_apic[i] != cpus[0].apic_id)
+                smp_wake(acpi_madt.cpu_apic[i], 0);
+        }
+    }
+    restore_flags(flags);
+    smp_delay(AP_WAIT_NS);
+
+    spin_lock(&smp_boot_lock);
+    smp_booted = 1;
+    for (i = 1; i < MAX_CPUS; i++)
+        smp_cpus += cpus[i].online;
+    spin_unlock(&smp_boot_lock);
+    map_low_page(AP_TRAMPOLINE, 0);
+    kstats.cpus = smp_cpus;
+    printf("%u processors online\n", smp_cpus);
+}
+
+
+/*
+ * ap_main
+ * DESCRIPTION: where another processor continues from the trampoline, on
+ *              its stack in ap_stacks and with interrupts off. It loads the
+ *              IDT and its own TSS, programs its PAT like the boot
+ *              processor's, starts its local APIC and then waits in
+ *              the scheduler for a process to run or steal.
+ * INPUTS: id - its number, 1 and up
+ * OUTPUTS: none
+ * RETURN VALUE: never returns
+ * SIDE EFFECTS: halts for good if smp_init already stopped waiting
+ */
+void ap_main(uint32_t id) {
+    uint32_t late;
+
+    asm volatile ("lidt idt_desc_ptr");
+    ltr(AP_TSS(id));
+    pat_init();                             /* same memory types as the boot processor */
+    lapic_ap_init();
+    cpus[id].apic_id = lapic_id();
+
+    spin_lock(&smp_boot_lock);
+    late = smp_booted;
+    if (!late)
+        cpus[id].online = 1;
+    spin_unlock(&smp_boot_lock);
+    while (late)
+        asm volatile ("cli; hlt");
+
+    (void)kernel_enter();
+    sched_start_cpu();
+}
@@ -0,0 +1,76 @@
+/* smp.h - Starting the other processors and what each of them keeps
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _SMP_H
+#define _SMP_H
+
+#include "types.h"
+#include "x86_desc.h"
+
+/* The other processors start in real mode at this page (startup IPI
+ * vector 0x08), where smp_init copies ap_trampoline */
+#define AP_TRAMPOLINE   0x8000
+/* Kernel stack each of them boots and idles on */
+#define AP_STACK_SHIFT  13
+#define AP_STACK_SIZE   (1 << AP_STACK_SHIFT)
+/* How long smp_init waits for them to come up */
+#define AP_INIT_NS      10000000            /* after INIT, before the startup IPIs */
+#define AP_SIPI_NS      200000              /* between the two startup IPIs */
+#define AP_WAIT_NS      100000000           /* for every one of them to check in */
+
+#ifndef ASM
+
+/* What each processor keeps for itself */
+struct cpu {
+    uint32_t apic_id;                       /* its local APIC, where IPIs go */
+    volatile uint32_t online;               /* 1 once it takes part in scheduling */
+    volatile uint32_t preempt;              /* its preempt_count, see preempt_disable */
+    volatile uint32_t resched;              /* its need_resched */
+    volatile int32_t curr;                  /* pid of the process it runs, -1 for none */
+    uint32_t runq;                          /* its run queue, a bit per pid, under sched_lock */
+    tss_t* tss;                             /* its kernel stack for entries from user mode */
+};
+
+/* Externally visible variables */
+extern struct cpu cpus[MAX_CPUS];
+/* processors online, 1 until smp_init found more */
+extern uint32_t smp_cpus;
+
+/* Number of the processor this runs on, 0 for the boot processor. Each
+ * one has its own TSS, so the task register tells them apart; it is 0
+ * before the boot processor loads its TSS. */
+static inline uint32_t smp_id(void) {
+    uint16_t sel;
+
+    asm volatile ("str %0" : "=rm"(sel));
+    return sel <= KERNEL_TSS ? 0 : (sel - KERNEL_LDT) >> 3;
+}
+
+/* The running processor's struct cpu */
+#define smp_cpu() (&cpus[smp_id()])
+
+/* Externally visible functions */
+/* starts every other processor and waits for them to come online */
+void smp_init(void);
+/* C entry of the other processors, from ap_start32 */
+void ap_main(uint32_t id) __attribute__((noreturn));
+/* takes the kernel lock unless this processor holds it; 1 if it did */
+int32_t kernel_enter(void);
+/* releases the kernel lock if kernel_enter took it */
+void kernel_exit(int32_t took);
+/* lets go of the kernel lock for a while if this processor holds it */
+int32_t kernel_release(void);
+/* asks processor cpu to look at its run queue again */
+void smp_resched(uint32_t cpu);
+
+/* In smp_boot.S */
+extern uint8_t ap_trampoline[];
+extern uint8_t ap_gdtr[];
+extern uint8_t ap_trampoline_end[];
+extern uint32_t ap_cr3;
+extern uint32_t ap_cr4;
+
+#endif /* ASM */
+
+#endif /* _SMP_H */
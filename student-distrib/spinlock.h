@@ -0,0 +1,46 @@
+/* spinlock.h - Locks for data shared between processors
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+
+/* A lock a processor busy-waits on. cli only keeps out this processor's
+ * own interrupts; anything another processor can touch at the same time
+ * needs one of these as well. Not recursive. */
+typedef struct spinlock {
+    volatile uint32_t locked;               /* 1 while held */
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+/* Takes the lock if it is free; returns 1 if it did, 0 if not */
+static inline int32_t spin_trylock(spinlock_t* lock) {
+    uint32_t old = 1;
+
+    asm volatile ("xchgl %0, %1"            /* xchg with memory is always locked */
+            : "+r"(old), "+m"(lock->locked)
+            :
+            : "memory");
+    return old == 0;
+}
+
+/* Takes the lock, waiting for it as long as it takes. The wait only
+ * reads, so the cache line isn't bounced around while it is held. */
+static inline void spin_lock(spinlock_t* lock) {
+    while (!spin_trylock(lock)) {
+        while (lock->locked)
+            asm volatile ("pause");
+    }
+}
+
+/* Releases the lock. x86 doesn't reorder stores with earlier loads or
+ * stores, so a plain store does, after a compiler barrier. */
+static inline void spin_unlock(spinlock_t* lock) {
+    asm volatile ("" : : : "memory");
+    lock->locked = 0;
+}
+
+#endif /* _SPINLOCK_H */
@@ -0,0 +1,116 @@
+/* stats.h - Kernel statistics counters, copied out by the kstat system call
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "types.h"
+
+/*
+ * Every counter only ever goes up, so user programs take the
+ * difference of two snapshots to measure something. The few
+ * fields that are not counters say so.
+ * Keep in sync with ece391_kstats_t in ece391syscall.h.
+ */
+struct kstats
+{
+	uint32_t ra_reads;		// sequential file reads
+	uint32_t ra_hits;		// ...whose blocks were already read ahead
+	uint32_t ra_blocks;		// blocks read ahead
+	uint32_t exec_loads;	// executables loaded by execute
+	uint32_t exec_hits;		// ...from a cached image
+	uint32_t exec_misses;	// ...that had to be read from the file
+	uint32_t exec_evicts;	// cached images dropped
+	uint32_t exec_cycles;	// cycles spent loading (low 32 bits)
+	uint32_t exec_shared;	// pages mapped from a cached image instead of copied
+	uint32_t cow_copies;	// copy-on-write pages that had to be copied
+	uint32_t tlb_flushes;	// cr3 loads (address space switches and full flushes)
+	uint32_t tlb_pages;		// single pages invalidated with invlpg
+	uint32_t scrolls;		// terminal lines scrolled
+	uint32_t scroll_cycles;	// cycles spent scrolling (low 32 bits)
+	uint32_t zero_depth;	// frames in the pre-zeroed pool now (not a counter)
+	uint32_t zero_filled;	// frames zeroed while idle
+	uint32_t zero_hits;		// zeroed frames taken from the pool
+	uint32_t zero_empty;	// ...or cleared on the spot because it was empty
+	uint32_t zero_spent;	// zeroed frames alloc_frame fell back on, out of memory
+	uint32_t swap_outs;		// pages compressed into swap
+	uint32_t swap_stored;	// ...and the compressed bytes they took
+	uint32_t swap_rejects;	// pages that didn't compress well enough
+	uint32_t swap_ins;		// pages decompressed on a fault
+	uint32_t swap_in_cycles;	// cycles spent decompressing (low 32 bits)
+	uint32_t swap_pages;	// pages in swap now (not a counter)
+	uint32_t high_chunks;	// 4MiB chunks found above 4GiB (not a counter)
+	uint32_t high_used;		// ...mapped by processes now (not a counter)
+	uint32_t irq_lat_samples;	// RTC ticks timed for interrupt latency
+	uint32_t irq_lat_max;	// worst cycles a tick was held up (not a counter)
+	uint32_t preempt_deferred;	// reschedules put off until preempt_enable
+	uint32_t timer_ticks;	// scheduler ticks
+	uint32_t ctx_switches;	// switches from one process to another
+	uint32_t sched_demotions;	// processes moved down a level for using their quantum
+	uint32_t sched_wakeups;	// blocked processes woken (and moved up)
+	uint32_t sched_boosts;	// times every process was put back on top
+	uint32_t echo_lines;	// lines a waiting terminal_read got
+	uint32_t echo_cycles;	// ...cycles from enter to the reader running (low 32 bits)
+	uint32_t echo_max;		// ...the longest of those (not a counter)
+	uint32_t timer_irqs;	// PIT interrupts, fewer than ticks while idle
+	uint32_t timer_oneshots;	// ...that armed a one-shot instead of ticking
+	uint32_t rtc_irqs;		// RTC interrupts, none while nobody has it open
+	uint32_t ktimers_fired;		// kernel timers that ran their callback
+	uint32_t ktimer_cascades;	// ...moves of a timer down a level of the wheel
+	uint32_t cpus;			// processors online
+	uint32_t sched_steals;		// processes an idle processor took from another one's queue
+	uint32_t kernel_lock_waits;	// kernel entries that had to wait for another processor
+} __attribute__((packed));
+
+extern struct kstats kstats;
+
+/* How long interrupts stay disabled, read by sys_irqoff
+ * Bucket 0 counts windows under 2^IRQOFF_SHIFT cycles, bucket i
+ * those under 2^(IRQOFF_SHIFT+i) and the last one everything longer */
+#define IRQOFF_BUCKETS 16
+#define IRQOFF_SHIFT 11
+#define IRQOFF_SITES 8
+#define IRQOFF_FILE 16
+
+struct irqoff_site {
+	uint32_t cycles;		// longest window opened here
+	uint32_t line;			// line of the cli (or handler) in file
+	int8_t file[IRQOFF_FILE];	// source file, cut to fit
+} __attribute__((packed));
+
+struct irqoff_stats {
+	uint32_t windows;		// times interrupts were turned off
+	uint32_t max;			// longest window, in cycles (not a counter)
+	uint32_t hist[IRQOFF_BUCKETS];
+	struct irqoff_site sites[IRQOFF_SITES];	// places with the longest windows
+} __attribute__((packed));
+
+extern struct irqoff_stats irqoff;
+
+/* Interrupts of each registered vector, read by sys_irqstat
+ * Latency runs from the vector's entry stub to its EOI. Bucket 0 counts
+ * interrupts under 2^IRQ_LAT_SHIFT cycles, bucket i those under
+ * 2^(IRQ_LAT_SHIFT+i) and the last one everything longer */
+#define IRQ_SLOTS 16
+#define IRQ_LAT_BUCKETS 16
+#define IRQ_LAT_SHIFT 8
+#define IRQ_NAME 12
+
+struct irq_vec_stats {
+	uint32_t vector;
+	uint32_t count;			// interrupts taken
+	uint32_t eois;			// ...that reached their EOI, the ones in hist
+	uint32_t max;			// longest entry to EOI, in cycles (not a counter)
+	uint32_t hist[IRQ_LAT_BUCKETS];
+	int8_t name[IRQ_NAME];	// what irq_register was told
+} __attribute__((packed));
+
+struct irq_stats {
+	uint32_t nvec;			// vectors registered, in registration order
+	struct irq_vec_stats vec[IRQ_SLOTS];
+} __attribute__((packed));
+
+extern struct irq_stats irq_stats;
+
+#endif /* _STATS_H */
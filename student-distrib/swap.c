@@ -0,0 +1,301 @@
+/* swap.c - Compressed in-memory swap for user pages
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#include "swap.h"
+#include "lib.h"
+#include "paging.h"
+#include "stats.h"
+
+/*
+ * The codec is a small LZ77 in the LZ4 style: a token byte holds the
+ * literal count (high nibble) and match length - 4 (low nibble), 15
+ * meaning more length bytes follow; then the literals, then a 2 byte
+ * offset back into the output. The last sequence has literals only.
+ */
+#define LZ_MIN_MATCH	4
+#define LZ_HASH_BITS	12
+#define LZ_HASH_SIZE	(1 << LZ_HASH_BITS)
+
+/* A storage frame and which of its chunks are taken */
+struct zframe
+{
+	uint32_t frame;		//0 if the entry is unused
+	uint16_t used;		//one bit per chunk
+};
+
+/* Where a compressed page lives */
+struct zslot
+{
+	uint16_t zf;		//index into zframes
+	uint8_t chunk;		//first chunk
+	uint8_t nchunks;
+	uint16_t len;		//compressed bytes
+	uint16_t used;
+};
+
+/* Local variables */
+static struct zframe zframes[ZSWAP_FRAMES];
+static struct zslot zslots[ZSWAP_SLOTS];
+static uint16_t lz_table[LZ_HASH_SIZE];		// last position (+1) of each hashed 4 bytes
+static uint8_t lz_buf[ZSWAP_MAX];			// compressed page before it is placed
+
+/* reads 4 bytes that may be unaligned */
+static inline uint32_t lz_read32(const uint8_t* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t lz_hash(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+/* writes the rest of a length that didn't fit in its nibble */
+static uint8_t* lz_put_len(uint8_t* op, uint32_t len)
+{
+	while(len >= 255)
+	{
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = len;
+	return op;
+}
+
+/*
+ * lz_sequence
+ * DESCRIPTION: writes one sequence: literals, then a match unless mlen is 0
+ * INPUTS: output position and its end, literals and how many, match
+ *         length and offset
+ * OUTPUTS: new output position, NULL if it doesn't fit
+ */
+static uint8_t* lz_sequence(uint8_t* op, uint8_t* end, const uint8_t* lit, uint32_t nlit,
+							uint32_t mlen, uint32_t off)
+{
+	uint32_t ml = mlen ? mlen - LZ_MIN_MATCH : 0;
+	if(op + 1 + nlit / 255 + 1 + nlit + 2 + ml / 255 + 1 > end)
+		return NULL;
+	*op++ = ((nlit < 15 ? nlit : 15) << 4) | (ml < 15 ? ml : 15);
+	if(nlit >= 15)
+		op = lz_put_len(op, nlit - 15);
+	memcpy(op, lit, nlit);
+	op += nlit;
+	if(mlen == 0)
+		return op;
+	*op++ = off & 0xFF;
+	*op++ = off >> 8;
+	if(ml >= 15)
+		op = lz_put_len(op, ml - 15);
+	return op;
+}
+
+/*
+ * lz_compress
+ * DESCRIPTION: compresses one page
+ * INPUTS: the page, output buffer and its size
+ * OUTPUTS: compressed size, -1 if it doesn't fit in cap
+ */
+static int32_t lz_compress(const uint8_t* src, uint8_t* dst, uint32_t cap)
+{
+	uint32_t ip = 0, anchor = 0, ref, len, h;
+	uint8_t* op = dst;
+
+	memset(lz_table, 0, sizeof(lz_table));
+	while(ip + LZ_MIN_MATCH <= FRAME_SIZE)
+	{
+		h = lz_hash(lz_read32(src + ip));
+		ref = lz_table[h];
+		lz_table[h] = ip + 1;
+		if(ref == 0 || lz_read32(src + ref - 1) != lz_read32(src + ip))
+		{
+			ip++;
+			continue;
+		}
+		ref--;
+		for(len = LZ_MIN_MATCH; ip + len < FRAME_SIZE && src[ref + len] == src[ip + len]; len++);
+		if((op = lz_sequence(op, dst + cap, src + anchor, ip - anchor, len, ip - ref)) == NULL)
+			return -1;
+		ip += len;
+		anchor = ip;
+	}
+	if((op = lz_sequence(op, dst + cap, src + anchor, FRAME_SIZE - anchor, 0, 0)) == NULL)
+		return -1;
+	return op - dst;
+}
+
+/* reads the rest of a length that didn't fit in its nibble */
+static const uint8_t* lz_get_len(const uint8_t* ip, const uint8_t* end, uint32_t* len)
+{
+	uint8_t b;
+	do
+	{
+		if(ip >= end)
+			return NULL;
+		b = *ip++;
+		*len += b;
+	} while(b == 255);
+	return ip;
+}
+
+/*
+ * lz_decompress
+ * DESCRIPTION: expands what lz_compress made back into a page
+ * INPUTS: compressed data and its size, the page to fill
+ * OUTPUTS: 0 on success, -1 if the data is bad
+ */
+static int32_t lz_decompress(const uint8_t* src, uint32_t n, uint8_t* dst)
+{
+	const uint8_t* ip = src;
+	const uint8_t* end = src + n;
+	uint32_t op = 0, nlit, mlen, off, t;
+
+	while(ip < end)
+	{
+		t = *ip++;
+		nlit = t >> 4;
+		if(nlit == 15 && (ip = lz_get_len(ip, end, &nlit)) == NULL)
+			return -1;
+		if(ip + nlit > end || op + nlit > FRAME_SIZE)
+			return -1;
+		memcpy(dst + op, ip, nlit);
+		ip += nlit;
+		op += nlit;
+		if(ip == end)
+			break;			//last sequence, no match
+		if(ip + 2 > end)
+			return -1;
+		off = ip[0] | (ip[1] << 8);
+		ip += 2;
+		mlen = t & 15;
+		if(mlen == 15 && (ip = lz_get_len(ip, end, &mlen)) == NULL)
+			return -1;
+		mlen += LZ_MIN_MATCH;
+		if(off == 0 || off > op || op + mlen > FRAME_SIZE)
+			return -1;
+		for(; mlen > 0; mlen--, op++)		//byte by byte, a match can overlap itself
+			dst[op] = dst[op - off];
+	}
+	return (op == FRAME_SIZE) ? 0 : -1;
+}
+
+/*
+ * zspace
+ * DESCRIPTION: finds n free chunks in a row in some storage frame,
+ *              taking a new storage frame if allowed and needed. The new
+ *              frame must already be free: alloc_frame could swap to make
+ *              room, and swap_store would run inside itself.
+ * INPUTS: chunks wanted, 1 if a new frame may be taken
+ * OUTPUTS: storage frame index (chunk in *chunk), -1 if there is no room
+ */
+static int32_t zspace(uint32_t n, uint32_t may_grow, uint32_t* chunk)
+{
+	uint32_t i, c, mask = (1 << n) - 1;
+	int32_t empty = -1;
+	for(i = 0; i < ZSWAP_FRAMES; i++)
+	{
+		if(zframes[i].frame == 0)
+		{
+			if(empty < 0)
+				empty = i;
+			continue;
+		}
+		for(c = 0; c + n <= ZSWAP_CHUNKS; c++)
+		{
+			if(!(zframes[i].used & (mask << c)))
+			{
+				*chunk = c;
+				return i;
+			}
+		}
+	}
+	if(!may_grow || empty < 0 || (zframes[empty].frame = alloc_free_frame()) == 0)
+		return -1;
+	zframes[empty].used = 0;
+	*chunk = 0;
+	return empty;
+}
+
+/*
+ * swap_store
+ * DESCRIPTION: compresses a user page into swap storage
+ * INPUTS: frame holding the page, 1 if a new storage frame may be taken
+ * OUTPUTS: slot number, -1 if the page doesn't compress well enough or
+ *          there is no room (the frame is left alone either way)
+ */
+int32_t swap_store(uint32_t frame, uint32_t may_grow)
+{
+	int32_t len, zf, slot;
+	uint32_t n, chunk;
+
+	for(slot = 0; slot < ZSWAP_SLOTS && zslots[slot].used; slot++);
+	if(slot == ZSWAP_SLOTS)
+		return -1;
+	zslots[slot].used = 1;		//taken before anything else can look for one
+	if((len = lz_compress((uint8_t*)frame, lz_buf, ZSWAP_MAX)) < 0)
+	{
+		zslots[slot].used = 0;
+		kstats.swap_rejects++;
+		return -1;
+	}
+	n = (len + ZSWAP_CHUNK - 1) / ZSWAP_CHUNK;
+	if((zf = zspace(n, may_grow, &chunk)) < 0)
+	{
+		zslots[slot].used = 0;
+		return -1;
+	}
+
+	zframes[zf].used |= ((1 << n) - 1) << chunk;
+	memcpy((void*)(zframes[zf].frame + chunk * ZSWAP_CHUNK), lz_buf, len);
+	zslots[slot].zf = zf;
+	zslots[slot].chunk = chunk;
+	zslots[slot].nchunks = n;
+	zslots[slot].len = len;
+	kstats.swap_outs++;
+	kstats.swap_stored += len;
+	kstats.swap_pages++;
+	return slot;
+}
+
+/*
+ * swap_drop
+ * DESCRIPTION: frees a slot, and its storage frame once that is empty
+ * INPUTS: slot number
+ * OUTPUTS: none
+ */
+void swap_drop(uint32_t slot)
+{
+	struct zslot* s;
+	if(slot >= ZSWAP_SLOTS || !zslots[slot].used)
+		return;
+	s = &zslots[slot];
+	zframes[s->zf].used &= ~(((1 << s->nchunks) - 1) << s->chunk);
+	if(zframes[s->zf].used == 0)
+	{
+		free_frame(zframes[s->zf].frame);
+		zframes[s->zf].frame = 0;
+	}
+	s->used = 0;
+	kstats.swap_pages--;
+}
+
+/*
+ * swap_load
+ * DESCRIPTION: decompresses a swapped page and frees its slot
+ * INPUTS: slot number, frame to fill
+ * OUTPUTS: 0 on success, -1 if the slot is bad
+ */
+int32_t swap_load(uint32_t slot, uint32_t frame)
+{
+	struct zslot* s;
+	uint64_t start = rdtsc();
+	if(slot >= ZSWAP_SLOTS || !zslots[slot].used)
+		return -1;
+	s = &zslots[slot];
+	if(lz_decompress((uint8_t*)(zframes[s->zf].frame + s->chunk * ZSWAP_CHUNK), s->len, (uint8_t*)frame))
+		return -1;
+	swap_drop(slot);
+	kstats.swap_ins++;
+	kstats.swap_in_cycles += (uint32_t)(rdtsc() - start);
+	return 0;
+}
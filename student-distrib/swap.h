@@ -0,0 +1,35 @@
+/* swap.h - Compressed in-memory swap for user pages
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _SWAP_H
+#define _SWAP_H
+
+#include "types.h"
+
+/*
+ * Cold user pages are compressed into 256 byte chunks of storage
+ * frames taken from the frame pool. A page only goes to swap if it
+ * compresses to 3KiB or less; its page table entry then keeps the
+ * slot number where the frame address was.
+ */
+#define ZSWAP_CHUNK		256
+#define ZSWAP_CHUNKS	16		/* chunks per storage frame */
+#define ZSWAP_MAX		3072	/* biggest compressed page we keep */
+#define ZSWAP_FRAMES	1024	/* storage frames (4MiB) */
+#define ZSWAP_SLOTS		4096	/* pages held at once */
+
+/* Swap pages out when fewer frames than this are free */
+#define SWAP_LOW_WATER	768
+#define SWAP_BATCH		8		/* pages looked at per idle call */
+
+/* Externally-visible functions */
+
+/* compresses a frame into swap, returns its slot or -1 */
+int32_t swap_store(uint32_t frame, uint32_t may_grow);
+/* decompresses a slot into a frame and frees the slot, -1 if it is bad */
+int32_t swap_load(uint32_t slot, uint32_t frame);
+/* frees a slot without reading it */
+void swap_drop(uint32_t slot);
+
+#endif /* _SWAP_H */
@@ -9,11 +9,14 @@
 #include "x86_desc.h"
 #include "rtc.h"
 #include "terminal.h"
+#include "stats.h"
+#include "elf.h"
+#include "timer.h"
 
 
 /* Local variables */
+struct kstats kstats;   // counters read by sys_kstat
 //struct fap fap_func_arr[3];
-const static int8_t check_exe[4] = {0x7f, 0x45, 0x4c, 0x46};  // first 4 bytes identifying an executable
 static struct fap terminal_op_table = {.read = terminal_read, .write = terminal_write, .open = terminal_open_fail, .close = terminal_close_fail};
 static struct fap rtc_op_table = {.read = rtc_read, .write = rtc_write, .open = rtc_open, .close = rtc_close};
 static struct fap dir_op_table = {.read = dir_read, .write = dir_write, .open = dir_open, .close = dir_close};
@@ -40,6 +43,19 @@ PCB is implemented*/
 }*/
 
 
+/*
+ * user_ok
+ * DESCRIPTION: whether the kernel may access a buffer the caller passed:
+ *              mapped user memory anywhere (program pages, mmap region,
+ *              big pages), writable if the kernel fills it in
+ * INPUTS: buf, its size in bytes, 1 if it will be written
+ * OUTPUTS: 1 if so, 0 if not
+ */
+static int32_t user_ok(const void* buf, uint32_t nbytes, uint32_t write) {
+    return user_range_ok(get_pcb()->pid, (uint32_t)buf, nbytes, write);
+}
+
+
 /* System call functions */
 
 /*
@@ -49,32 +65,38 @@ PCB is implemented*/
  * OUTPUTS: status 
  */
 int32_t sys_halt(uint8_t status) {
-    union dirEntry d;
     pcb_t* pcb = get_pcb();
 
     // close all files
     int i;
-    for (i = 0; i < MAX_FILES; i++) {
-        pcb->file_desc_tb[0].flag = 0;
-        pcb->active = 0;
+    for (i = 2; i < MAX_FILES; i++) {
+        if (pcb->file_desc_tb[i].flag)
+            sys_close(i);               // the RTC stops ticking when its last user goes
     }
+    pcb->active = 0;
+    user_release(pcb->pid);
 
     // printf("halt: pid: %d, parent pid: %d\n", pcb->pid, pcb->parent_pid);
     if (pcb->parent_pid == -1) {
-        pcb->pid--;
+        // the first shell of a terminal is started again
         clear_term();
-        sys_execute((uint8_t*)"shell");
+        process_execute((uint8_t*)"shell", -1, pcb->term);
+        // it only comes back if the shell couldn't be loaded (out of frames,
+        // say); there is no parent to return to, so the terminal goes without
+        // a process until the scheduler manages to start its shell
+        sched_set_leaf(pcb->term, -1);
+        sched_restart_term(pcb->term);
+        pcb->state = TASK_DEAD;
+        schedule();                     // never comes back
     }
     
-    // restore parent's paging
-    d.val = 7;		//sets P and RW bits
-    d.whole.ps = 1;
-	d.whole.add_22_31 = (_8MB + _4MB * pcb->parent_pid) >> 22; //bit shift by 22 to access correct address
-	chgDir(32, d);	//32 = 128 / 4 (all programs are in the 128-132 MiB vmem page
-    flushTLB();
-
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = _8MB - (pcb->parent_pid) * _8KB - 4; //subtract 4 for padding
+    // back to the parent's address space; no interrupts on the way, the
+    // parent's iret puts the flags back
+    cli();
+    irqoff_end();                      // the window is closed by the iret, not by sti
+    sched_set_leaf(pcb->term, pcb->parent_pid);
+    user_switch(pcb->parent_pid);
+    sched_set_current(pcb->parent_pid);   // the parent continues on this processor
 
     asm volatile(
         "movl %0, %%esp;"
@@ -91,18 +113,33 @@ int32_t sys_halt(uint8_t status) {
 
 /*
  * system_execute
- * DESCRIPTION: loads and executes a new program
+ * DESCRIPTION: loads and executes a new program as a child of the caller,
+ *              on the caller's terminal
  * INPUTS: command (space separated squence of words)
- * OUTPUTS: returns 0 if successful, returns -1 if program isn't executable
+ * OUTPUTS: returns the child's status once it halts, -1 if program isn't executable
  */
 int32_t sys_execute(const uint8_t * command) {
+    pcb_t* pcb = get_pcb();
+    return process_execute(command, pcb->pid, pcb->term);
+}
+
+
+/*
+ * process_execute
+ * DESCRIPTION: loads and executes a new program. The first shell of each
+ *              terminal has no parent: it is started again when it halts.
+ * INPUTS: command (space separated squence of words), pid of the parent
+ *         (-1 for none) and the terminal the program uses
+ * OUTPUTS: returns the child's status once it halts, -1 if program isn't executable
+ */
+int32_t process_execute(const uint8_t * command, int32_t parent, uint32_t term) {
     uint8_t command_name[MAX_CMD_LEN] = {0};     // first word of the command
     uint8_t args[128] = {0}; //args buffer is 128 in length including null char
-    uint8_t exe[40] = {0};  // header occupies first 40 bytes of the file
+    struct elf_header exe;
     struct dentry command_dentry;
     uint32_t command_inode;
     uint32_t entry_point;                 // entry point of the executable
-	union dirEntry d;
+    uint32_t image_end;                   // first page after the program, where its heap starts
 
     // copy command into a buffer until /0 or /n is reached
     int i = 0;
@@ -136,41 +173,57 @@ int32_t sys_execute(const uint8_t * command) {
     
     command_inode = command_dentry.ind;
 
-    // check ELF header to see if it is a executable (read_data first 4 bytes)
-    read_data(command_inode, 0, (uint8_t *)exe, 40);        //40 bytes
-    if (strncmp((int8_t *) exe, (int8_t *) check_exe, 4))   //4 bytes
+    // check ELF header to see if it is a executable
+    if (elf_check(command_inode, &exe))
         return -1; // not an executable
 
-    // get entry point from ELF header
-    entry_point = (((uint32_t)(exe[24]) & 0xFF) + (((uint32_t)(exe[25]) & 0xFF) << 8) + (((uint32_t)(exe[26]) & 0xFF) << 16) + (((uint32_t)(exe[27]) & 0xFF) << 24)); //bits [24:27] of executable contain EIP
-    // find first active pcb
+    // find first inactive pcb; a dead process another processor still idles
+    // on the kernel stack of isn't free yet
 	int pcb_index = 0;
-	while (pcb_index < MAX_PROCESSES && curr_pcb[pcb_index]->active) pcb_index++;
+	while (pcb_index < MAX_PROCESSES && (curr_pcb[pcb_index]->active ||
+	        (sched_on_cpu(pcb_index) && curr_pcb[pcb_index] != get_pcb()))) pcb_index++;
 	if (pcb_index == MAX_PROCESSES) return -1;  // no available pcb's
 
     // put arguments in pcb
     strcpy((int8_t *)curr_pcb[pcb_index]->args, (const int8_t *)args);
 
-    // set up paging for the program (flush TLB)
-	d.val = 7;		//sets P, RW, and US bits 0b111
-    d.whole.ps = 1;
-	d.whole.add_22_31 = (_8MB + _4MB * pcb_index) >> 22; 
-	chgDir(32, d);	//32 = 128 / 4 (all programs are in the 128-132 MiB vmem page)
-	flushTLB();
+    // load the program's segments into its own pages, then reserve the stack
+    user_release(pcb_index);
+    if (elf_load(command_inode, pcb_index, &entry_point, &image_end)) {
+        user_release(pcb_index);
+        return -1; // bad program headers or out of memory
+    }
+    for (i = 1; i <= USER_STACK_PAGES; i++)
+        map_user_zero(pcb_index, _132MB - i * _4KB, 1);
 
-    // load in data
-	read_data(command_inode, 0, (uint8_t *)(_128MB + PROC_OFFSET), KERNEL_STACK_BOTTOM);
+    // switch to the program's address space; nothing may run between
+    // here and the iret into the program, which turns interrupts back on
+    cli();
+    irqoff_end();                      // the window is closed by the iret, not by sti
+    user_switch(pcb_index);
+    sched_set_leaf(term, pcb_index);
+    select_term(term);
 
     // set up and load pcb (setup fd[0] and fd[1])
     curr_pcb[pcb_index]->pid = pcb_index;
     curr_pcb[pcb_index]->active = 1;
-    curr_pcb[pcb_index]->parent_pid = curr_pcb[pcb_index]->pid - 1;
+    curr_pcb[pcb_index]->parent_pid = parent;
+    curr_pcb[pcb_index]->term = term;
+    curr_pcb[pcb_index]->state = TASK_READY;
+    curr_pcb[pcb_index]->nice = (parent == -1) ? 0 : curr_pcb[parent]->nice;
+    curr_pcb[pcb_index]->level = NICE_LEVEL(curr_pcb[pcb_index]->nice);
+    curr_pcb[pcb_index]->slice = 0;
     curr_pcb[pcb_index]->saved_esp = _8MB - 1;
+    curr_pcb[pcb_index]->mmap_top = 0;
+    curr_pcb[pcb_index]->brk_start = image_end;
+    curr_pcb[pcb_index]->brk = image_end;
+    curr_pcb[pcb_index]->big_top = 0;
+    curr_pcb[pcb_index]->sleep_timer.next = NULL;
     curr_pcb[pcb_index]->file_desc_tb[0].flag = 1;
     curr_pcb[pcb_index]->file_desc_tb[0].f_op = &terminal_op_table;
     curr_pcb[pcb_index]->file_desc_tb[1].flag = 1;
     curr_pcb[pcb_index]->file_desc_tb[1].f_op = &terminal_op_table;
-    for (i = 2; i < MAX_PROCESSES; i++) {
+    for (i = 2; i < MAX_FILES; i++) {
         curr_pcb[pcb_index]->file_desc_tb[i].flag = 0;
     }
 
@@ -181,9 +234,8 @@ int32_t sys_execute(const uint8_t * command) {
     // 0x083FFFFC
     uint32_t user_sp = _132MB - 4;  //find user space
 
-    // set up tss
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = _8MB - curr_pcb[pcb_index]->pid * _8KB - 4;  //find EIP
+    // set up this processor's tss
+    sched_set_current(pcb_index);
 	// asm volatile(
 	// 	"movl %%cr3, %0;"
 	// 	"movl %%esp, %1;"
@@ -201,7 +253,8 @@ int32_t sys_execute(const uint8_t * command) {
         : "=r" (curr_pcb[pcb_index]->saved_esp), "=r" (curr_pcb[pcb_index]->saved_ebp)
     );
     
-    // context switch
+    // context switch; the kernel lock is this processor's until the iret
+    kernel_exit(1);
     asm volatile(
         "movw %0, %%ax;"
         "movw %%ax, %%ds;"
@@ -299,6 +352,9 @@ int32_t sys_open (const uint8_t* filename){
                 pcb->file_desc_tb[i].flag=1;
                 pcb->file_desc_tb[i].file_position=0;
                 pcb->file_desc_tb[i].inode = d.ind;
+                pcb->file_desc_tb[i].ra_next = 0;
+                pcb->file_desc_tb[i].ra_size = 0;
+                pcb->file_desc_tb[i].ra_end = 0;
                 break;
             }
         }
@@ -410,7 +466,7 @@ int32_t sys_close (int32_t fd){
     if (pcb->file_desc_tb[fd].flag == 0){
         return -1;
     }
-    // pcb->file_desc_tb[fd].f_op->close(fd);
+    pcb->file_desc_tb[fd].f_op->close(fd);
     // pcb->file_desc_tb[fd].f_op->close = NULL;
     // pcb->file_desc_tb[fd].f_op->read = NULL;
 	// pcb->file_desc_tb[fd].f_op->write = NULL;
@@ -494,3 +550,383 @@ int32_t sys_sethandler (int32_t signum, void* handler_address){
 int32_t sys_sigreturn (void){
     return -1;
 }
+
+/*getdents
+*DESCRIPTION: reads as many directory records (name, type, inode, size) as fit into buf
+*INPUTS: fd of an open directory, user buffer and its size in bytes
+*OUTPUTS: bytes written (multiple of sizeof(struct dirent)), 0 at the end of the directory, -1 on failure
+*SIDE EFFECTS: advances the directory position by the number of records returned
+*/
+int32_t sys_getdents (int32_t fd, void* buf, int32_t nbytes){
+    pcb_t * pcb = get_pcb();
+
+    if (fd < 2 || fd > 7 || buf == NULL || nbytes < 0)
+        return -1;
+    if (pcb->file_desc_tb[fd].flag == 0 || pcb->file_desc_tb[fd].f_op != &dir_op_table)
+        return -1;  // not an open directory
+    if (!user_ok(buf, nbytes, 1))
+        return -1;  // buffer is outside of user memory
+
+    return dir_getdents(fd, buf, nbytes);
+}
+
+/*stat
+*DESCRIPTION: looks up a file by name and reports its type, inode, size and block count
+*INPUTS: filename, user stat buffer
+*OUTPUTS: 0 on success, -1 if the file does not exist or buf is outside of user space
+*SIDE EFFECTS: fills in buf
+*/
+int32_t sys_stat (const uint8_t* filename, struct stat* buf){
+    struct dentry d;
+
+    if (filename == NULL || !user_ok(buf, sizeof(struct stat), 1))
+        return -1;
+    if (read_dentry_by_name(filename, &d))
+        return -1;
+
+    return read_stat(d.ft, d.ind, buf);
+}
+
+/*fstat
+*DESCRIPTION: reports type, inode, size and block count of an open file descriptor
+*INPUTS: fd, user stat buffer
+*OUTPUTS: 0 on success, -1 for invalid or terminal descriptors
+*SIDE EFFECTS: fills in buf
+*/
+int32_t sys_fstat (int32_t fd, struct stat* buf){
+    pcb_t * pcb = get_pcb();
+    struct fap * f_op;
+
+    if (fd < 2 || fd > 7 || !user_ok(buf, sizeof(struct stat), 1))
+        return -1;
+    if (pcb->file_desc_tb[fd].flag == 0)
+        return -1;
+
+    f_op = pcb->file_desc_tb[fd].f_op;
+    if (f_op == &rtc_op_table)
+        return read_stat(0, 0, buf);    // device
+    if (f_op == &dir_op_table)
+        return read_stat(1, 0, buf);    // the only directory is "."
+    return read_stat(2, pcb->file_desc_tb[fd].inode, buf);
+}
+
+/*lseek
+*DESCRIPTION: moves the read position of an open regular file
+*INPUTS: fd, offset, whence (SEEK_SET, SEEK_CUR or SEEK_END)
+*OUTPUTS: new position from the start of the file, -1 on failure
+*SIDE EFFECTS: changes the file position used by read
+*/
+int32_t sys_lseek (int32_t fd, int32_t offset, int32_t whence){
+    pcb_t * pcb = get_pcb();
+
+    if (fd < 2 || fd > 7)
+        return -1;
+    if (pcb->file_desc_tb[fd].flag == 0 || pcb->file_desc_tb[fd].f_op != &file_op_table)
+        return -1;  // only regular files have positions to seek
+
+    return file_lseek(fd, offset, whence);
+}
+
+/*pread
+*DESCRIPTION: reads from an open regular file at a given offset
+*INPUTS: fd, user buffer, number of bytes, offset from the start of the file
+*OUTPUTS: number of bytes read (0 past the end of the file), -1 on failure
+*SIDE EFFECTS: does not change the file position used by read
+*/
+int32_t sys_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset){
+    pcb_t * pcb = get_pcb();
+
+    if (fd < 2 || fd > 7 || buf == NULL || nbytes < 0)
+        return -1;
+    if (pcb->file_desc_tb[fd].flag == 0 || pcb->file_desc_tb[fd].f_op != &file_op_table)
+        return -1;
+    if (!user_ok(buf, nbytes, 1))
+        return -1;  // buffer is outside of user memory
+
+    return file_pread(fd, buf, nbytes, offset);
+}
+
+/*mmap
+*DESCRIPTION: maps the blocks of an open regular file straight from the filesystem image
+*             into the caller's mmap region, without copying. With fd -1 the mapping is
+*             anonymous: length bytes of zeroed memory, given frames on first touch.
+*             Anonymous mappings of 4MB or more use whole 4MB pages from above 4GB
+*             when the machine has memory there
+*INPUTS: fd (or -1), length in bytes (0 maps the whole file), prot (PROT_READ, optionally PROT_WRITE)
+*OUTPUTS: user address of the mapping, -1 on failure
+*SIDE EFFECTS: with PROT_WRITE each file page is copied on its first write, so the image
+*              itself is never changed; mappings last until munmap or the process halts
+*/
+int32_t sys_mmap (int32_t fd, uint32_t length, int32_t prot){
+    pcb_t * pcb = get_pcb();
+    struct stat st;
+    uint32_t i, npages, start;
+
+    if (prot & ~(PROT_READ | PROT_WRITE))
+        return -1;
+    if (fd == -1 && length >= BIG_SIZE) {
+        npages = (length + BIG_SIZE - 1) / BIG_SIZE;
+        if (npages <= BIG_DIRS - pcb->big_top && npages <= high_avail()) {
+            start = BIG_START + pcb->big_top * BIG_SIZE;
+            for (i = 0; i < npages; i++) {
+                if (map_user_big(pcb->pid, start + i * BIG_SIZE, (prot & PROT_WRITE) ? 1 : 0))
+                    break;
+            }
+            if (i == npages) {
+                pcb->big_top += npages;
+                return start;
+            }
+            while (i-- > 0)     // undo the part that was mapped
+                unmap_user_big(pcb->pid, start + i * BIG_SIZE);
+        }
+        // no memory above 4GB to spare, try with 4KB pages
+    }
+    if (fd == -1) {
+        if (length == 0 || length > MMAP_PAGES * _4KB)
+            return -1;
+        npages = (length + _4KB - 1) / _4KB;
+        if (pcb->mmap_top + npages > MMAP_PAGES)
+            return -1;  // region is full
+        start = MMAP_START + pcb->mmap_top * _4KB;
+        for (i = 0; i < npages; i++)
+            map_user_zero(pcb->pid, start + i * _4KB, (prot & PROT_WRITE) ? 1 : 0);
+        pcb->mmap_top += npages;
+        return start;
+    }
+    if (fd < 2 || fd > 7)
+        return -1;
+    if (pcb->file_desc_tb[fd].flag == 0 || pcb->file_desc_tb[fd].f_op != &file_op_table)
+        return -1;  // only regular files live in the image
+    if (read_stat(2, pcb->file_desc_tb[fd].inode, &st))
+        return -1;
+
+    if (length == 0 || length > st.len)
+        length = st.len;
+    if (length == 0)
+        return -1;  // nothing to map
+    npages = (length + _4KB - 1) / _4KB;
+    if (pcb->mmap_top + npages > MMAP_PAGES)
+        return -1;  // region is full
+
+    start = MMAP_START + pcb->mmap_top * _4KB;
+    for (i = 0; i < npages; i++) {
+        map_user_page(pcb->pid, start + i * _4KB,
+            (uint32_t)file_block(pcb->file_desc_tb[fd].inode, i), (prot & PROT_WRITE) ? PG_COW : 0);
+    }
+    pcb->mmap_top += npages;
+    // the pages were not present before, so the TLB holds nothing to flush
+
+    return start;
+}
+
+/*munmap
+*DESCRIPTION: unmaps whole pages of the caller's mmap region. When the range reaches the
+*             top of the region, the region shrinks back so later mappings reuse it
+*INPUTS: addr (page aligned, inside a 4KB page mapping), length in bytes
+*OUTPUTS: 0 on success, -1 on failure
+*SIDE EFFECTS: frames of anonymous and copied pages are freed; the 4MB pages stay until halt
+*/
+int32_t sys_munmap (void* addr, uint32_t length){
+    pcb_t * pcb = get_pcb();
+    uint32_t va, start = (uint32_t)addr;
+    uint32_t end = MMAP_START + pcb->mmap_top * _4KB;
+
+    if (length == 0 || (start & (_4KB - 1)))
+        return -1;
+    if (start < MMAP_START || start >= end || length > end - start)
+        return -1;  // not in the mapped part of the region
+
+    for (va = start; va < start + length; va += _4KB)
+        unmap_user_page(pcb->pid, va);
+    if (va >= end)
+        pcb->mmap_top = (start - MMAP_START) / _4KB;
+
+    return 0;
+}
+
+/*kstat
+*DESCRIPTION: copies the kernel statistics counters to the user
+*INPUTS: user buffer and its size in bytes
+*OUTPUTS: number of bytes copied (at most sizeof(struct kstats)), -1 on failure
+*SIDE EFFECTS: none
+*/
+int32_t sys_kstat (void* buf, int32_t nbytes){
+    if (buf == NULL || nbytes < 0)
+        return -1;
+    if (!user_ok(buf, nbytes, 1))
+        return -1;  // buffer is outside of user memory
+
+    if (nbytes > sizeof(struct kstats))
+        nbytes = sizeof(struct kstats);
+    memcpy(buf, &kstats, nbytes);
+    return nbytes;
+}
+
+/*irqoff
+*DESCRIPTION: copies the interrupts-disabled statistics (histogram of how long interrupts
+*             stayed off and the places that kept them off longest) to the user
+*INPUTS: user buffer and its size in bytes
+*OUTPUTS: number of bytes copied (at most sizeof(struct irqoff_stats)), -1 on failure
+*SIDE EFFECTS: none
+*/
+int32_t sys_irqoff (void* buf, int32_t nbytes){
+    uint32_t flags;
+
+    if (buf == NULL || nbytes < 0)
+        return -1;
+    if (!user_ok(buf, nbytes, 1))
+        return -1;  // buffer is outside of user memory
+
+    if (nbytes > sizeof(struct irqoff_stats))
+        nbytes = sizeof(struct irqoff_stats);
+    cli_and_save(flags);    // a consistent copy, handlers update it
+    memcpy(buf, &irqoff, nbytes);
+    restore_flags(flags);
+    return nbytes;
+}
+
+/*nice
+*DESCRIPTION: makes the caller nicer to other processes (or less nice). Nicer processes
+*             can't climb back to the top levels of the scheduler's queue: 0 to 6 may use
+*             every level, 7 to 13 start one down and 14 to 19 only run on the lowest
+*INPUTS: amount to add to the nice value, negative to lower it
+*OUTPUTS: the new nice value, kept between 0 and NICE_MAX
+*SIDE EFFECTS: children started afterwards inherit the value
+*/
+int32_t sys_nice (int32_t increment){
+    pcb_t * pcb = get_pcb();
+    int32_t nice = pcb->nice + increment;
+
+    if (nice < 0)
+        nice = 0;
+    if (nice > NICE_MAX)
+        nice = NICE_MAX;
+    pcb->nice = nice;
+    if (pcb->level < NICE_LEVEL(nice))
+        pcb->level = NICE_LEVEL(nice);
+    return nice;
+}
+
+/*clock_gettime
+*DESCRIPTION: reads the kernel's monotonic clock, nanoseconds since boot. Programs can
+*             read the same clock from the time page without a system call while it
+*             runs on the TSC
+*INPUTS: clock (only CLOCK_MONOTONIC) and a user timespec to fill in
+*OUTPUTS: 0 on success, -1 on failure
+*SIDE EFFECTS: none
+*/
+int32_t sys_clock_gettime (int32_t clock, struct timespec* ts){
+    if (clock != CLOCK_MONOTONIC || ts == NULL)
+        return -1;
+    if (!user_ok(ts, sizeof(struct timespec), 1))
+        return -1;  // buffer is outside of user memory
+
+    clock_timespec(ts);
+    return 0;
+}
+
+/* sleep_expired: timer callback that wakes the process sleeping on it */
+static void sleep_expired(void* data){
+    pcb_t * pcb = data;
+
+    pcb->sleep_done = 1;
+    sched_wake(&pcb->sleep_done);
+}
+
+/* sleep_ticks: blocks the caller until the ticks-th tick from now, in steps the
+*  timer wheel can hold */
+static void sleep_ticks(uint64_t ticks){
+    pcb_t * pcb = get_pcb();
+    uint32_t chunk;
+
+    pcb->sleep_timer.fn = sleep_expired;
+    pcb->sleep_timer.data = pcb;
+    while (ticks > 0) {
+        chunk = ticks > WHEEL_MAX_TICKS ? WHEEL_MAX_TICKS : ticks;
+        ticks -= chunk;
+        pcb->sleep_done = 0;
+        ktimer_add(&pcb->sleep_timer, chunk);
+        sched_wait(&pcb->sleep_done);
+    }
+}
+
+/*nanosleep
+*DESCRIPTION: blocks the caller for at least the given time, rounded up to whole timer
+*             ticks. The process is off the run queue until its timer on the timer
+*             wheel fires; with nothing else to run the tick stops until then
+*INPUTS: a user timespec, nsec below 1000000000
+*OUTPUTS: 0 on success, -1 on failure
+*SIDE EFFECTS: none
+*/
+int32_t sys_nanosleep (const struct timespec* req){
+    if (req == NULL || !user_ok(req, sizeof(struct timespec), 0))
+        return -1;  // buffer is outside of user memory
+    if (req->nsec >= NSEC_PER_SEC)
+        return -1;
+
+    // the first tick may come right away, so it doesn't count
+    sleep_ticks(div_u64((uint64_t)req->sec * NSEC_PER_SEC + req->nsec + TICK_NS - 1, TICK_NS) + 1);
+    return 0;
+}
+
+/*sleep
+*DESCRIPTION: nanosleep for whole seconds
+*INPUTS: seconds
+*OUTPUTS: 0
+*SIDE EFFECTS: none
+*/
+int32_t sys_sleep (uint32_t seconds){
+    sleep_ticks((uint64_t)seconds * TICK_RATE + 1);
+    return 0;
+}
+
+/*irqstat
+*DESCRIPTION: copies the interrupt statistics (count of each registered vector and a
+*             histogram of how long it took from its entry to its EOI) to the user
+*INPUTS: user buffer and its size in bytes
+*OUTPUTS: number of bytes copied (at most sizeof(struct irq_stats)), -1 on failure
+*SIDE EFFECTS: none
+*/
+int32_t sys_irqstat (void* buf, int32_t nbytes){
+    uint32_t flags;
+
+    if (buf == NULL || nbytes < 0)
+        return -1;
+    if (!user_ok(buf, nbytes, 1))
+        return -1;  // buffer is outside of user memory
+
+    if (nbytes > sizeof(struct irq_stats))
+        nbytes = sizeof(struct irq_stats);
+    cli_and_save(flags);    // a consistent copy, handlers update it
+    memcpy(buf, &irq_stats, nbytes);
+    restore_flags(flags);
+    return nbytes;
+}
+
+/*sbrk
+*DESCRIPTION: grows or shrinks the heap, which starts right after the loaded program
+*             and may grow up to the stack
+*INPUTS: increment in bytes (negative to shrink, 0 to just ask for the current end)
+*OUTPUTS: the previous end of the heap, -1 if it can't move that far
+*SIDE EFFECTS: new pages are zero-filled on first touch, pages given back are unmapped
+*/
+int32_t sys_sbrk (int32_t increment){
+    pcb_t * pcb = get_pcb();
+    uint32_t old = pcb->brk;
+    uint32_t new = old + increment;
+    uint32_t va;
+
+    if (increment > 0 && (new < old || new > USER_STACK))
+        return -1;
+    if (increment < 0 && (new > old || new < pcb->brk_start))
+        return -1;
+
+    // pages that were partly in use stay, only whole pages come and go
+    for (va = (old + _4KB - 1) & ~(_4KB - 1); va < new; va += _4KB)
+        map_user_zero(pcb->pid, va, 1);
+    for (va = (new + _4KB - 1) & ~(_4KB - 1); va < old; va += _4KB)
+        unmap_user_page(pcb->pid, va);
+    pcb->brk = new;
+
+    return old;
+}
@@ -7,21 +7,19 @@
 
 #include "types.h"
 #include "filesystem.h"
+#include "timer.h"
 
 /* Page directory and page table constants */
 #define PAGE_DIR_SIZE 1024
 #define _132MB 0x08400000
 #define _128MB 0x08000000
-#define PROC_OFFSET 0x00048000
 #define _8MB 0x00800000
 #define _4MB 0x00400000
 #define _8KB 0x00002000
 #define _4KB 0x00001000
 #define MAX_CMD_LEN 32
-#define MAX_PROCESSES 6
 #define MAX_FILES 8
 #define USER_STACK_POINTER 
-#define KERNEL_STACK_BOTTOM (PAGE_DIR_SIZE - 1) * _4KB
 
 /* System call numbers */
 #define SYS_HALT 1
@@ -34,6 +32,20 @@
 #define SYS_VIDMAP 8
 #define SYS_SET_HANDLER 9
 #define SYS_SIGRETURN 10
+#define SYS_GETDENTS 11
+#define SYS_STAT 12
+#define SYS_FSTAT 13
+#define SYS_LSEEK 14
+#define SYS_PREAD 15
+#define SYS_MMAP 16
+#define SYS_KSTAT 17
+#define SYS_SBRK 18
+#define SYS_IRQOFF 19
+#define SYS_NICE 20
+
+/* mmap protection bits, a writable mapping is private copy-on-write */
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
 
 /* Local functions */
 int32_t sys_halt(uint8_t status);
@@ -46,6 +58,22 @@ int32_t sys_getargs (uint8_t* buf, int32_t nbytes);
 int32_t sys_vidmap (uint8_t** screen_start);
 int32_t sys_sethandler (int32_t signum, void* handler_address);
 int32_t sys_sigreturn (void);
+int32_t sys_getdents (int32_t fd, void* buf, int32_t nbytes);
+int32_t sys_stat (const uint8_t* filename, struct stat* buf);
+int32_t sys_fstat (int32_t fd, struct stat* buf);
+int32_t sys_lseek (int32_t fd, int32_t offset, int32_t whence);
+int32_t sys_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+int32_t sys_mmap (int32_t fd, uint32_t length, int32_t prot);
+int32_t sys_kstat (void* buf, int32_t nbytes);
+int32_t sys_sbrk (int32_t increment);
+int32_t sys_irqoff (void* buf, int32_t nbytes);
+int32_t sys_nice (int32_t increment);
+int32_t sys_clock_gettime (int32_t clock, struct timespec* ts);
+int32_t sys_nanosleep (const struct timespec* req);
+int32_t sys_sleep (uint32_t seconds);
+int32_t sys_irqstat (void* buf, int32_t nbytes);
+int32_t sys_munmap (void* addr, uint32_t length);
+int32_t process_execute(const uint8_t * command, int32_t parent, uint32_t term);
 
 /* Wrapper function for syscall handler */
 void syscall_wrapper();
@@ -5,6 +5,8 @@
 #include "terminal.h"
 #include "lib.h"
 #include "keyboard.h"
+#include "scheduling.h"
+#include "stats.h"
 
 /* Local variables */
 // must have a separate input buffer for each terminal
@@ -30,6 +32,9 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes) {
     // read from keyboard buffer to buf until a newline '\n' or as much as fits in the buffer
     // if the buffer is full, return -1
 	int i;
+    uint32_t flags, lat;
+    uint32_t t = current_term();        // the process's terminal, not the one on screen
+    int waited = !enterpress[t];
    // char c = 0;
     if (buf == NULL) {
         return -1;
@@ -37,26 +42,31 @@ int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes) {
     if (nbytes > 128) nbytes = 128;
     //char temp_buffer[128] = {0};
 
-    sti();
-
     // while(keyboard_buffer[0] == '\0');
     i = 0;
-    while(!enterpress);
+    sched_wait(&enterpress[t]);         // other processes run until enter is pressed
+    if (waited) {
+        // time from the enter key to the reader running again
+        lat = (uint32_t)rdtsc() - enter_tsc[t];
+        kstats.echo_lines++;
+        kstats.echo_cycles += lat;
+        if (lat > kstats.echo_max)
+            kstats.echo_max = lat;
+    }
     for (i = 0; i < 128; i++) {
-        if ((char) keyboard_buffer[i] == '\n')
+        if ((char) keyboard_buffer[t][i] == '\n')
         break;
     }
 
     //clear buffer
     //putc(i + '0');
-    strncpy((char*)buf, keyboard_buffer, i + 1);
-    memset(keyboard_buffer, 0, 128);
-    enterpress = 0;
+    cli_and_save(flags);                // keep the keyboard out of the buffer while we take it
+    strncpy((char*)buf, keyboard_buffer[t], i + 1);
+    memset(keyboard_buffer[t], 0, 128);
+    enterpress[t] = 0;
+    restore_flags(flags);
     // add newline character to the end of the buffer
     // *((char*)buf + i + 1) = '\n';
-    // sti();
-
-    cli();
     
     return i + 1;
 }
@@ -68,15 +78,18 @@ int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes) {
     // write to screen
     // return number of bytes written
 	int i;
-    cli();
+    uint32_t flags;
     if (nbytes <= 0 || buf == NULL) {
-        sti();
         return -1;
     } else {
+        // interrupts are only off for one character at a time (the keyboard
+        // echoes through the same cursor), so a long write can't hold them up
         for (i = 0; i < nbytes; i++) {
+            cli_and_save(flags);
             putc_term(((char*)buf)[i]);
+            restore_flags(flags);
+            cond_resched();
         }
-        sti();
         return nbytes;
     }
     
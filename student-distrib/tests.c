@@ -6,6 +6,17 @@
 #include "rtc.h"
 #include "filesystem.h"
 #include "syscall.h"
+#include "elf.h"
+#include "stats.h"
+#include "scheduling.h"
+#include "swap.h"
+#include "timer.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "acpi.h"
+#include "ioapic.h"
+#include "irq.h"
+#include "keyboard.h"
 
 #define PASS 1
 #define FAIL 0
@@ -282,6 +293,458 @@ int list_all_files_test(){
 	return PASS;
 }
 
+int getdents_test(){
+	TEST_HEADER;
+	int i, n, total;
+	struct dirent ents[8];		//small buffer so the listing takes several calls
+	pcb_t* p = get_pcb();
+	p->file_desc_tb[2].file_position = 0;
+	total = 0;
+	clear();
+	while((n = dir_getdents(2, ents, sizeof(ents))) > 0){
+		for(i = 0; i < n / sizeof(struct dirent); i++){
+			printf("%d %d %d\n", ents[i].ft, ents[i].ind, ents[i].len);
+		}
+		total += n / sizeof(struct dirent);
+	}
+	if(n != 0 || total == 0){
+		return FAIL;
+	}
+	if(dir_getdents(2, ents, sizeof(struct dirent) - 1) != 0){	//at end, nothing left to fit
+		return FAIL;
+	}
+	return PASS;
+}
+
+int stat_test(){
+	TEST_HEADER;
+	struct dentry dent;
+	struct stat st;
+	uint8_t c;
+	if(read_dentry_by_name((uint8_t*)"frame0.txt", &dent) != 0 || read_stat(dent.ft, dent.ind, &st) != 0){
+		return FAIL;
+	}
+	if(st.ft != 2 || st.ind != dent.ind || st.len == 0 || st.nblck != (st.len + 4095) / 4096){
+		return FAIL;	//4096 bytes per data block
+	}
+	if(read_data(st.ind, st.len - 1, &c, 1) != 1 || read_data(st.ind, st.len, &c, 1) != 0){
+		return FAIL;	//the last byte is at len - 1
+	}
+	if(read_dentry_by_name((uint8_t*)".", &dent) != 0 || read_stat(dent.ft, dent.ind, &st) != 0 || st.len != 0 || st.nblck != 0){
+		return FAIL;	//directories have no size
+	}
+	if(read_stat(2, 0xFFFFFFFF, &st) != -1){
+		return FAIL;	//no such inode
+	}
+	return PASS;
+}
+
+int lseek_pread_test(){
+	TEST_HEADER;
+	int fd;
+	uint8_t* fn = (uint8_t*)"frame0.txt";
+	uint8_t head[16], tail[16];			//16 bytes compared from each end
+	fd = file_open(fn);
+	if(fd == -1){
+		return FAIL;
+	}
+	if(file_lseek(fd, -16, SEEK_END) < 0 || file_read(fd, tail, 16) != 16){
+		return FAIL;
+	}
+	if(file_lseek(fd, 0, SEEK_SET) != 0 || file_pread(fd, head, 16, 0) != 16){
+		return FAIL;
+	}
+	if(file_read(fd, tail, 16) != 16 || strncmp((int8_t*)head, (int8_t*)tail, 16) != 0){
+		return FAIL;	//pread must not have moved the position
+	}
+	if(file_lseek(fd, -1, SEEK_SET) != -1 || file_pread(fd, head, 16, 1 << 20) != 0){
+		return FAIL;	//1 << 20 is past the end of the file
+	}
+	file_close(fd);
+	return PASS;
+}
+
+int exec_cache_test(){
+	TEST_HEADER;
+	struct dentry d;
+	uint32_t first, second, end, hits;
+	if(read_dentry_by_name((uint8_t*)"ls", &d) != 0){
+		return FAIL;
+	}
+	//load into the last pcb's pages twice, the second load must be a hit
+	if(elf_load(d.ind, MAX_PROCESSES - 1, &first, &end) != 0){
+		return FAIL;
+	}
+	user_release(MAX_PROCESSES - 1);
+	hits = kstats.exec_hits;
+	if(elf_load(d.ind, MAX_PROCESSES - 1, &second, &end) != 0){
+		return FAIL;
+	}
+	user_release(MAX_PROCESSES - 1);
+	if(first != second || kstats.exec_hits != hits + 1){
+		return FAIL;
+	}
+	return PASS;
+}
+
+int shared_text_test(){
+	TEST_HEADER;
+	struct dentry d;
+	uint32_t entry, end, shared;
+	if(read_dentry_by_name((uint8_t*)"ls", &d) != 0){
+		return FAIL;
+	}
+	//two instances at once, the second maps the same pages as the first
+	if(elf_load(d.ind, MAX_PROCESSES - 2, &entry, &end) != 0){
+		return FAIL;
+	}
+	shared = kstats.exec_shared;
+	if(elf_load(d.ind, MAX_PROCESSES - 1, &entry, &end) != 0){
+		return FAIL;
+	}
+	user_release(MAX_PROCESSES - 2);
+	user_release(MAX_PROCESSES - 1);
+	if(kstats.exec_shared == shared){
+		return FAIL;
+	}
+	return PASS;
+}
+
+int page_dir_test(){
+	TEST_HEADER;
+	uint32_t a, b;
+	//each process gets its own directory, the kernel stays mapped in both
+	user_switch(MAX_PROCESSES - 2);
+	asm volatile("movl %%cr3, %0" : "=r"(a));
+	user_switch(MAX_PROCESSES - 1);
+	asm volatile("movl %%cr3, %0" : "=r"(b));
+	user_switch(get_pcb()->pid);
+	if(a == b || (a & 0xFFF) || (b & 0xFFF)){	//directories are 4KiB aligned
+		return FAIL;
+	}
+	return PASS;
+}
+
+int global_pages_test(){
+	TEST_HEADER;
+	uint32_t cr4, edx, flushes;
+	asm volatile("cpuid" : "=d" (edx) : "a" (1) : "ebx", "ecx");
+	asm volatile("movl %%cr4, %0" : "=r"(cr4));
+	if((edx & (1 << 13)) && !(cr4 & 0x80)){	//PGE supported but not enabled
+		return FAIL;
+	}
+	flushes = kstats.tlb_flushes;
+	flushPage(0xB8000);			//video memory, must not count as a full flush
+	if(kstats.tlb_flushes != flushes){
+		return FAIL;
+	}
+	return PASS;
+}
+
+int pat_test(){
+	TEST_HEADER;
+	uint32_t lo, hi, edx;
+	asm volatile("cpuid" : "=d" (edx) : "a" (1) : "ebx", "ecx");
+	if(!(edx & (1 << 16))){		//no PAT, nothing to check
+		return PASS;
+	}
+	asm volatile("rdmsr" : "=a" (lo), "=d" (hi) : "c" (PAT_MSR));
+	if(((lo >> 8) & 0xFF) != PAT_WC){	//entry 1 is what MEM_WC selects
+		return FAIL;
+	}
+	return PASS;
+}
+
+int sbrk_test(){
+	TEST_HEADER;
+	pcb_t* p = get_pcb();
+	uint32_t base = USER_STACK - 2 * _4KB;		//two pages of room below the stack
+	p->brk_start = base;
+	p->brk = base;
+	if(sys_sbrk(_4KB + 1) != base || sys_sbrk(0) != base + _4KB + 1){
+		return FAIL;
+	}
+	if(sys_sbrk(_4KB) != -1){			//would run into the stack
+		return FAIL;
+	}
+	if(sys_sbrk(-(_4KB + 1)) != base + _4KB + 1 || sys_sbrk(-1) != -1){
+		return FAIL;				//can't shrink below the start
+	}
+	return PASS;
+}
+
+int zero_pool_test(){
+	TEST_HEADER;
+	uint32_t i, frame, hits;
+	if(zero_pool_refill(ZERO_BATCH) == 0 || kstats.zero_depth == 0){
+		return FAIL;
+	}
+	hits = kstats.zero_hits;
+	if((frame = alloc_zeroed_frame()) == 0 || kstats.zero_hits != hits + 1){
+		return FAIL;
+	}
+	for(i = 0; i < FRAME_SIZE; i++){
+		if(((uint8_t*)frame)[i] != 0){
+			return FAIL;
+		}
+	}
+	free_frame(frame);
+	return PASS;
+}
+
+int swap_roundtrip_test(){
+	TEST_HEADER;
+	uint32_t i, a, b;
+	int32_t slot;
+	if((a = alloc_frame()) == 0 || (b = alloc_frame()) == 0){
+		return FAIL;
+	}
+	for(i = 0; i < FRAME_SIZE; i++){
+		((uint8_t*)a)[i] = (i / 7) % 13;		//repetitive, compresses well
+	}
+	if((slot = swap_store(a, 1)) < 0 || swap_load(slot, b) != 0){
+		return FAIL;
+	}
+	for(i = 0; i < FRAME_SIZE; i++){
+		if(((uint8_t*)a)[i] != ((uint8_t*)b)[i]){
+			return FAIL;
+		}
+	}
+	free_frame(a);
+	free_frame(b);
+	return PASS;
+}
+
+int highmem_test(){
+	TEST_HEADER;
+	if(kstats.high_chunks == 0){
+		return PASS;		//no memory above 4GB, nothing to check
+	}
+	if(high_avail() + kstats.high_used != kstats.high_chunks){
+		return FAIL;
+	}
+	return PASS;
+}
+
+int preempt_nest_test(){
+	TEST_HEADER;
+	uint32_t depth = preempt_count;
+	preempt_disable();
+	preempt_disable();
+	need_resched = 1;
+	preempt_enable();
+	if(preempt_count != depth + 1 || !need_resched){
+		return FAIL;		//still disabled, the reschedule must wait
+	}
+	preempt_enable();
+	if(preempt_count != depth || (depth == 0 && need_resched)){
+		return FAIL;
+	}
+	need_resched = 0;
+	return PASS;
+}
+
+int irqoff_window_test(){
+	TEST_HEADER;
+	uint32_t flags, inner, before = irqoff.windows;
+	cli_and_save(flags);
+	cli_and_save(inner);		//nested, must not start a second window
+	restore_flags(inner);
+	restore_flags(flags);
+	if((flags & 0x200) && irqoff.windows != before + 1){
+		return FAIL;
+	}
+	return PASS;
+}
+
+int sched_wake_test(){
+	TEST_HEADER;
+	volatile int32_t flag = 0;
+	int woke;
+	pcb_t* p = curr_pcb[MAX_PROCESSES - 1];
+	if(p->active){
+		return PASS;		//in use, nothing to try it on
+	}
+	p->active = 1;
+	p->state = TASK_BLOCKED;
+	p->wait = &flag;
+	p->nice = NICE_MAX;
+	p->level = 0;
+	sched_wake(&flag);
+	//woken, but a niced process can't go above its own level
+	woke = p->state == TASK_READY && p->level == NICE_LEVEL(NICE_MAX);
+	p->active = 0;
+	need_resched = 0;
+	return woke ? PASS : FAIL;
+}
+
+int rtc_demand_test(){
+	TEST_HEADER;
+	uint8_t on, off;
+	rtc_open(0);
+	outb(RTC_REG_B, RTC_PORT);
+	on = inb(RTC_DATA);
+	rtc_close(2);		//any descriptor but 0
+	outb(RTC_REG_B, RTC_PORT);
+	off = inb(RTC_DATA);
+	//periodic interrupt (0x40) only while the RTC is open
+	return ((on & 0x40) && !(off & 0x40)) ? PASS : FAIL;
+}
+
+int clock_monotonic_test(){
+	TEST_HEADER;
+	int i;
+	uint64_t prev, now;
+	//constant divides are done by the compiler, so this checks div_u64
+	if(div_u64(0x0123456789ABCDEFULL, 1000) != 0x0123456789ABCDEFULL / 1000){
+		return FAIL;
+	}
+	prev = clock_ns();
+	for(i = 0; i < 1000; i++){
+		now = clock_ns();
+		if(now < prev){
+			return FAIL;
+		}
+		prev = now;
+	}
+	return PASS;
+}
+
+int time_page_test(){
+	TEST_HEADER;
+	struct timespec ts;
+	//where programs see it, through the vidmap directory entry
+	volatile struct time_page* tp = (volatile struct time_page*)TIME_PAGE_USER;
+	clock_timespec(&ts);
+	if((tp->seq & 1) || tp->mult == 0 || ts.nsec >= NSEC_PER_SEC){
+		return FAIL;
+	}
+	//published at the last interrupt, so it can't be ahead
+	return (tp->sec < ts.sec || (tp->sec == ts.sec && tp->nsec <= ts.nsec)) ? PASS : FAIL;
+}
+
+#define WHEEL_TEST_TIMERS 2048
+static struct ktimer wheel_test_timers[WHEEL_TEST_TIMERS];
+static volatile int32_t wheel_test_fired;
+
+static void wheel_test_fn(void* data){
+	wheel_test_fired++;
+}
+
+int timer_wheel_test(){
+	TEST_HEADER;
+	int i;
+	uint64_t start;
+	wheel_test_fired = 0;
+	//even ones due within a second, some a level up; odd ones hours out
+	for(i = 0; i < WHEEL_TEST_TIMERS; i++){
+		wheel_test_timers[i].fn = wheel_test_fn;
+		wheel_test_timers[i].next = NULL;
+		ktimer_add(&wheel_test_timers[i], (i & 1) ? 100 + i * 4099 : 1 + i % 100);
+	}
+	for(i = 1; i < WHEEL_TEST_TIMERS; i += 2){
+		if(ktimer_del(&wheel_test_timers[i]) != 1){
+			return FAIL;
+		}
+	}
+	start = clock_ns();
+	while(wheel_test_fired < WHEEL_TEST_TIMERS / 2 && clock_ns() - start < 2 * NSEC_PER_SEC){
+		kernel_idle();
+	}
+	if(wheel_test_fired != WHEEL_TEST_TIMERS / 2 || ktimer_del(&wheel_test_timers[0]) != 0){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* SMP basics
+ *
+ * The boot processor is number 0 and online, holds the kernel lock while
+ * it runs tests, and a spinlock can only be taken once.
+ */
+int smp_basics_test(){
+	TEST_HEADER;
+	spinlock_t lock = SPINLOCK_INIT;
+	if(smp_id() != 0 || !cpus[0].online || smp_cpus < 1 || smp_cpus > MAX_CPUS){
+		return FAIL;
+	}
+	if(kernel_enter() != 0){
+		return FAIL;		//already ours, a nested entry must not take it again
+	}
+	if(!spin_trylock(&lock) || spin_trylock(&lock)){
+		return FAIL;
+	}
+	spin_unlock(&lock);
+	if(!spin_trylock(&lock)){
+		return FAIL;
+	}
+	return PASS;
+}
+
+/* IOAPIC routing
+ *
+ * Once the IOAPIC took over, every ISA IRQ the MADT maps to one of its
+ * inputs must be routed there, on the vector the 8259 would have used.
+ * Passes trivially on the 8259.
+ */
+int ioapic_test(){
+	TEST_HEADER;
+	int i;
+	uint32_t pins;
+	volatile uint32_t* sel = (uint32_t*)(acpi_madt.ioapic_base + IOAPIC_REGSEL);
+	volatile uint32_t* win = (uint32_t*)(acpi_madt.ioapic_base + IOAPIC_WIN);
+	if(!ioapic_on){
+		return PASS;
+	}
+	if(!acpi_madt.found || acpi_madt.ioapic_base == 0){
+		return FAIL;
+	}
+	cli();
+	*sel = IOAPIC_VER;
+	pins = ((*win >> 16) & 0xFF) + 1;
+	for(i = 0; i < ISA_IRQS; i++){
+		if(acpi_madt.isa_gsi[i] >= pins){
+			continue;		//not on this IOAPIC
+		}
+		*sel = IOAPIC_REDIR(acpi_madt.isa_gsi[i]);
+		if((*win & 0xFF) != IOAPIC_VECTOR(i)){
+			sti();
+			return FAIL;
+		}
+	}
+	sti();
+	return PASS;
+}
+
+/* IRQ registration
+ *
+ * Only vectors past the exceptions can be registered, never the system
+ * call. The keyboard's vector is registered and present, and no vector
+ * has more EOIs than interrupts.
+ */
+int irq_register_test(){
+	TEST_HEADER;
+	uint32_t i;
+	if(irq_register(14, keyboard_handler, "bad") != -1 ||
+			irq_register(IRQ_SYSCALL, keyboard_handler, "bad") != -1 ||
+			irq_register(IRQ_LAST + 1, keyboard_handler, "bad") != -1 ||
+			irq_register(IRQ_FIRST, NULL, "bad") != -1){
+		return FAIL;
+	}
+	if(!idt[IRQ_ISA_VECTOR(KEYBOARD_IRQ)].present || idt[IRQ_SYSCALL].dpl != 3){
+		return FAIL;
+	}
+	for(i = 0; i < irq_stats.nvec; i++){
+		if(irq_stats.vec[i].eois > irq_stats.vec[i].count){
+			return FAIL;
+		}
+		if(irq_stats.vec[i].vector == IRQ_ISA_VECTOR(KEYBOARD_IRQ)){
+			return PASS;
+		}
+	}
+	return FAIL;
+}
+
 /* Checkpoint 3 tests */
 
 int check_bad_input_2(){
@@ -329,6 +792,28 @@ void launch_tests(){
 	//TEST_OUTPUT("read file by name", read_file_by_name_test2());
 	//TEST_OUTPUT("read file by name executable", read_file_by_name_test_executable());
 	//TEST_OUTPUT("list all files", list_all_files_test());
+	//TEST_OUTPUT("getdents", getdents_test());
+	//TEST_OUTPUT("stat", stat_test());
+	//TEST_OUTPUT("lseek and pread", lseek_pread_test());
+	//TEST_OUTPUT("exec image cache", exec_cache_test());
+	//TEST_OUTPUT("shared text pages", shared_text_test());
+	//TEST_OUTPUT("per-process page directories", page_dir_test());
+	//TEST_OUTPUT("global pages and invlpg", global_pages_test());
+	//TEST_OUTPUT("write-combining PAT entry", pat_test());
+	//TEST_OUTPUT("sbrk", sbrk_test());
+	//TEST_OUTPUT("pre-zeroed frame pool", zero_pool_test());
+	//TEST_OUTPUT("compressed swap round trip", swap_roundtrip_test());
+	//TEST_OUTPUT("memory above 4GB", highmem_test());
+	//TEST_OUTPUT("nested preempt_disable", preempt_nest_test());
+	//TEST_OUTPUT("interrupts-off windows", irqoff_window_test());
+	//TEST_OUTPUT("scheduler wakeup", sched_wake_test());
+	//TEST_OUTPUT("rtc on demand", rtc_demand_test());
+	//TEST_OUTPUT("monotonic clock", clock_monotonic_test());
+	//TEST_OUTPUT("time page", time_page_test());
+	//TEST_OUTPUT("timer wheel", timer_wheel_test());
+	//TEST_OUTPUT("smp basics", smp_basics_test());
+	//TEST_OUTPUT("ioapic routing", ioapic_test());
+	//TEST_OUTPUT("irq registration", irq_register_test());
 	//TEST_OUTPUT("change rtc frequency", change_rtc_freq_test(3));
 	// TEST_OUTPUT("change rtc frequency", change_rtc_freq_test(15));	
 	TEST_OUTPUT("terminal test", terminal_read_test());
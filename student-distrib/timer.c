@@ -0,0 +1,522 @@
+/* timer.c - The kernel's clock and tick, on top of whichever clock
+ * source and clock event device the machine has
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#include "timer.h"
+#include "pit.h"
+#include "lib.h"
+#include "i8259.h"
+#include "irq.h"
+#include "scheduling.h"
+#include "stats.h"
+#include "paging.h"
+#include "smp.h"
+
+static int32_t tsc_probe(void);
+static uint64_t tsc_read(void);
+static void timer_arm(void);
+
+/* The time stamp counter: cheapest to read, calibrated against the PIT */
+static struct clocksource tsc_clocksource = {
+    .name = "tsc",
+    .rating = 300,
+    .probe = tsc_probe,
+    .read = tsc_read,
+    .mask = 0xFFFFFFFFFFFFFFFFULL,
+};
+
+/* Probed in this order, the TSC first while PIT channel 2 is still free
+ * for calibrating it; the best rated one that is there wins */
+static struct clocksource* clocksources[] = {
+    &tsc_clocksource, &hpet_clocksource, &pit_clocksource,
+};
+static struct clock_event* clock_events[] = {
+    &lapic_clock_event, &hpet_clock_event, &pit_clock_event, &rtc_clock_event,
+};
+
+/* Local variables */
+struct clock_event* clock_event = NULL;
+static struct clocksource* clocksource = NULL;
+// counter value and time of the last clock_fold
+static uint64_t clock_last = 0;
+static uint64_t clock_base = 0;
+// time the last scheduler tick was counted for
+static uint64_t tick_last = 0;
+// 1 while the clock event device is armed one-shot instead of ticking
+static uint32_t tick_nohz = 0;
+// the page user programs read the clock from, alone in its page
+static union {
+    struct time_page tp;
+    uint8_t page[FRAME_SIZE];
+} time_page __attribute__((aligned(FRAME_SIZE)));
+// the timer wheel, each slot the head of a circular list
+static struct ktimer wheel[WHEEL_LEVELS][WHEEL_SIZE];
+// the next tick the wheel runs for
+static uint32_t wheel_now = 0;
+// timers on the wheel
+static uint32_t wheel_pending = 0;
+
+
+/*
+ * tsc_probe
+ * DESCRIPTION: checks for a TSC and times it against the PIT
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: 0 if it can be used, -1 if not
+ * SIDE EFFECTS: sets tsc_clocksource.freq. The kernel never changes the
+ *               CPU's frequency, so a TSC that isn't invariant still
+ *               ticks at a steady rate.
+ */
+static int32_t tsc_probe(void) {
+    uint32_t edx;
+    uint64_t hz;
+
+    asm volatile ("cpuid" : "=d"(edx) : "a"(1) : "ebx", "ecx");
+    if (!(edx & (1 << 4)))
+        return -1;
+    hz = pit_calibrate(tsc_read);
+    if (hz == 0 || hz > 0xFFFFFFFF)
+        return -1;                          /* freq is 32 bits, good up to 4.2GHz */
+    tsc_clocksource.freq = hz;
+    return 0;
+}
+
+static uint64_t tsc_read(void) {
+    return rdtsc();
+}
+
+
+/*
+ * clocksource_scale
+ * DESCRIPTION: works out the mult and shift that turn counts of cs into
+ *              nanoseconds, keeping (counts * mult) in 64 bits for as long
+ *              as the counter may go unread
+ * INPUTS: cs - a probed clock source
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: sets cs->mult, cs->shift and cs->max_ns
+ */
+static void clocksource_scale(struct clocksource* cs) {
+    uint32_t shift = 32;
+    uint64_t mult, counts, ns;
+
+    while ((mult = div_u64((uint64_t)NSEC_PER_SEC << shift, cs->freq)) > 0xFFFFFFFF)
+        shift--;
+    cs->mult = mult;
+    cs->shift = shift;
+
+    counts = div_u64(0xFFFFFFFFFFFFFFFFULL, cs->mult);
+    if (counts > cs->mask)
+        counts = cs->mask;
+    ns = ((counts / 2) * cs->mult) >> cs->shift;      /* half, to be safe */
+    cs->max_ns = ns > TIMER_MAX_NS ? TIMER_MAX_NS : ns;
+}
+
+
+/*
+ * time_page_update
+ * DESCRIPTION: publishes the clock as of the last fold. Readers can't
+ *              lock anything, so seq is odd while the fields change and
+ *              they read again if it was odd or moved.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: interrupts must be off
+ */
+static void time_page_update(void) {
+    struct time_page* tp = &time_page.tp;
+    uint32_t sec = div_u64(clock_base, NSEC_PER_SEC);
+
+    tp->seq++;
+    asm volatile ("" : : : "memory");
+    tp->tsc_last = clock_last;
+    tp->sec = sec;
+    tp->nsec = clock_base - (uint64_t)sec * NSEC_PER_SEC;
+    asm volatile ("" : : : "memory");
+    tp->seq++;
+}
+
+
+/*
+ * clock_fold
+ * DESCRIPTION: adds the time since the last fold to clock_base, so the
+ *              counter never runs far enough to wrap or overflow the
+ *              conversion. Called on every timer interrupt.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: interrupts must be off
+ */
+static void clock_fold(void) {
+    uint64_t now = clocksource->read();
+
+    clock_base += (((now - clock_last) & clocksource->mask) * clocksource->mult) >> clocksource->shift;
+    clock_last = now;
+    time_page_update();
+}
+
+
+/*
+ * clock_ns
+ * DESCRIPTION: the kernel's monotonic clock
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: nanoseconds since timer_init, 0 before it
+ * SIDE EFFECTS: none
+ */
+uint64_t clock_ns(void) {
+    uint32_t flags;
+    uint64_t now, delta;
+    uint64_t ns;
+
+    if (clocksource == NULL)
+        return 0;
+    cli_and_save(flags);                    /* clock_last and clock_base change together */
+    now = clocksource->read();
+    delta = (now - clock_last) & clocksource->mask;
+    /* another processor's TSC may be a little behind the boot processor's,
+     * whose reading clock_last is; that isn't a wrap */
+    if (smp_cpus > 1 && delta > (clocksource->mask >> 1))
+        delta = 0;
+    ns = clock_base + ((delta * clocksource->mult) >> clocksource->shift);
+    restore_flags(flags);
+    return ns;
+}
+
+
+/*
+ * clock_timespec
+ * DESCRIPTION: the kernel's monotonic clock split into seconds and
+ *              nanoseconds
+ * INPUTS: ts - filled in
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void clock_timespec(struct timespec* ts) {
+    uint64_t ns = clock_ns();
+
+    ts->sec = div_u64(ns, NSEC_PER_SEC);
+    ts->nsec = ns - (uint64_t)ts->sec * NSEC_PER_SEC;
+}
+
+
+/*
+ * wheel_insert
+ * DESCRIPTION: hangs t in the slot for its expiry: level 0 if it is due
+ *              within WHEEL_SIZE ticks, otherwise the lowest level whose
+ *              slots reach that far. A timer already due goes in the slot
+ *              the wheel runs next.
+ * INPUTS: t - timer with expires set, not on the wheel
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: interrupts must be off
+ */
+static void wheel_insert(struct ktimer* t) {
+    uint32_t delta = t->expires - wheel_now;
+    uint32_t level, shift;
+    struct ktimer* head;
+
+    if ((int32_t)delta < 0) {
+        head = &wheel[0][wheel_now & WHEEL_MASK];
+    } else {
+        for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+            if (delta < (1U << (WHEEL_BITS * (level + 1))))
+                break;
+        }
+        shift = WHEEL_BITS * level;
+        head = &wheel[level][(t->expires >> shift) & WHEEL_MASK];
+    }
+    t->next = head;
+    t->prev = head->prev;
+    head->prev->next = t;
+    head->prev = t;
+}
+
+static void wheel_unlink(struct ktimer* t) {
+    t->prev->next = t->next;
+    t->next->prev = t->prev;
+    t->next = NULL;
+}
+
+/*
+ * wheel_cascade
+ * DESCRIPTION: moves the timers of one slot down to the levels below, now
+ *              that the wheel has come within that slot's reach of them
+ * INPUTS: level - 1 and up
+ *         idx - slot
+ * OUTPUTS: none
+ * RETURN VALUE: idx, so the caller knows whether the next level is due
+ * SIDE EFFECTS: interrupts must be off
+ */
+static uint32_t wheel_cascade(uint32_t level, uint32_t idx) {
+    struct ktimer* head = &wheel[level][idx];
+    struct ktimer* t;
+
+    while (head->next != head) {
+        t = head->next;
+        wheel_unlink(t);
+        wheel_insert(t);
+        kstats.ktimer_cascades++;
+    }
+    return idx;
+}
+
+/*
+ * wheel_run
+ * DESCRIPTION: runs the wheel for one tick. At the start of every round
+ *              of level 0 the next slot of level 1 is cascaded, and so on
+ *              up. The due slot is taken off first, so callbacks that add
+ *              timers (even for the next tick) don't run again now.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: calls the callbacks of every timer due; interrupts must
+ *               be off
+ */
+static void wheel_run(void) {
+    uint32_t idx = wheel_now & WHEEL_MASK;
+    uint32_t level;
+    struct ktimer due;
+    struct ktimer* head = &wheel[0][idx];
+    struct ktimer* t;
+
+    for (level = 1; idx == 0 && level < WHEEL_LEVELS; level++)
+        idx = wheel_cascade(level, (wheel_now >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    wheel_now++;
+    if (head->next == head)
+        return;
+
+    due.next = head->next;
+    due.prev = head->prev;
+    due.next->prev = &due;
+    due.prev->next = &due;
+    head->next = head->prev = head;
+    while (due.next != &due) {
+        t = due.next;
+        wheel_unlink(t);
+        wheel_pending--;
+        kstats.ktimers_fired++;
+        t->fn(t->data);
+    }
+}
+
+
+/*
+ * ktimer_add
+ * DESCRIPTION: sets t to run t->fn(t->data) from the timer interrupt on
+ *              the ticks-th tick from now, moving it if it was already
+ *              pending. The first tick can be anywhere from just now to a
+ *              full TICK_NS away. Waits of over WHEEL_MAX_TICKS are cut
+ *              short to that.
+ * INPUTS: t - timer with fn and data set
+ *         ticks - 0 counts as 1
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: reprograms the clock event device if it is one-shot
+ */
+void ktimer_add(struct ktimer* t, uint32_t ticks) {
+    uint32_t flags;
+
+    if (ticks == 0)
+        ticks = 1;
+    if (ticks > WHEEL_MAX_TICKS)
+        ticks = WHEEL_MAX_TICKS;
+    cli_and_save(flags);
+    if (t->next != NULL)
+        wheel_unlink(t);
+    else
+        wheel_pending++;
+    t->expires = wheel_now + ticks - 1;
+    wheel_insert(t);
+    if (tick_nohz)
+        timer_arm();                        /* it may be sooner than what is armed */
+    restore_flags(flags);
+}
+
+/*
+ * ktimer_del
+ * DESCRIPTION: takes t off the wheel. Once it returns the callback won't
+ *              run, unless it already is.
+ * INPUTS: t - timer
+ * OUTPUTS: none
+ * RETURN VALUE: 1 if it was pending, 0 if it had fired or was never added
+ * SIDE EFFECTS: none; the device may still interrupt at t's time
+ */
+int32_t ktimer_del(struct ktimer* t) {
+    uint32_t flags;
+    int32_t pending = 0;
+
+    cli_and_save(flags);
+    if (t->next != NULL) {
+        wheel_unlink(t);
+        wheel_pending--;
+        pending = 1;
+    }
+    restore_flags(flags);
+    return pending;
+}
+
+
+/*
+ * timer_next_event
+ * DESCRIPTION: how long the clock event device may stay quiet: until the
+ *              first non-empty slot of level 0, or the next cascade,
+ *              whichever comes first. Looks at no more than WHEEL_SIZE
+ *              slots however many timers there are.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: nanoseconds from now
+ * SIDE EFFECTS: interrupts must be off
+ */
+static uint32_t timer_next_event(void) {
+    uint32_t k, idx;
+    uint64_t when, now;
+
+    if (wheel_pending == 0)
+        return TIMER_MAX_NS;
+    for (k = 0; k < WHEEL_SIZE - 1; k++) {
+        idx = (wheel_now + k) & WHEEL_MASK;
+        if ((k != 0 && idx == 0) || wheel[0][idx].next != &wheel[0][idx])
+            break;
+    }
+    /* tick wheel_now is the one after tick_last */
+    when = tick_last + (uint64_t)(k + 1) * TICK_NS;
+    now = clock_ns();
+    if (when <= now)
+        return 0;
+    return when - now > TIMER_MAX_NS ? TIMER_MAX_NS : when - now;
+}
+
+
+/*
+ * timer_arm
+ * DESCRIPTION: arms the clock event device for one interrupt at the next
+ *              event, or sooner if the device or the clock source can't
+ *              wait that long
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: reprograms the clock event device
+ */
+static void timer_arm(void) {
+    uint32_t ns = timer_next_event();
+
+    if (ns > clock_event->max_ns)
+        ns = clock_event->max_ns;
+    if (ns > clocksource->max_ns)
+        ns = clocksource->max_ns;
+    clock_event->oneshot(ns);
+    kstats.timer_oneshots++;
+}
+
+
+/*
+ * timer_init
+ * DESCRIPTION: probes every clock source and clock event device, picks
+ *              the best rated of each and starts the periodic tick.
+ *              Clock event devices are probed after the clock is running
+ *              so they can be timed against it.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: enables the interrupt of the clock event device, maps
+ *               the time page
+ */
+void timer_init(void) {
+    uint32_t i, j;
+    struct clocksource* cs = NULL;
+    struct clock_event* ce = NULL;
+
+    for (i = 0; i < sizeof(clocksources) / sizeof(clocksources[0]); i++) {
+        if (clocksources[i]->probe() == 0 && (cs == NULL || clocksources[i]->rating > cs->rating))
+            cs = clocksources[i];
+    }
+    clocksource_scale(cs);                  /* the PIT is always there */
+    clock_last = cs->read();
+    clocksource = cs;
+    time_page.tp.tsc_valid = (cs == &tsc_clocksource);
+    time_page.tp.tsc_hz = tsc_clocksource.freq;
+    time_page.tp.mult = cs->mult;
+    time_page.tp.shift = cs->shift;
+    time_page_update();
+    map_time_page((uint32_t)&time_page);
+
+    for (i = 0; i < sizeof(clock_events) / sizeof(clock_events[0]); i++) {
+        if (clock_events[i]->probe() == 0 && (ce == NULL || clock_events[i]->rating > ce->rating))
+            ce = clock_events[i];
+    }
+    for (i = 0; i < WHEEL_LEVELS; i++) {
+        for (j = 0; j < WHEEL_SIZE; j++)
+            wheel[i][j].next = wheel[i][j].prev = &wheel[i][j];
+    }
+
+    clock_event = ce;
+    tick_last = clock_ns();
+    if (ce->irq >= 0) {
+        irq_register(IRQ_ISA_VECTOR(ce->irq), pit_handler, ce->name);
+        enable_irq(ce->irq);
+    }
+    ce->periodic();
+    printf("clocksource %s (%u Hz), clock event %s\n", cs->name, cs->freq, ce->name);
+}
+
+
+/*
+ * timer_interrupt
+ * DESCRIPTION: the tick. Brings the clock up to date, runs the timer
+ *              wheel and charges the scheduler for every tick that passed
+ *              since the last one; after a one-shot that can be many, or
+ *              none if the device fired early. Rearms the one-shot.
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: called with interrupts off, before the handler's
+ *               sched_irq_return
+ */
+void timer_interrupt(void) {
+    uint32_t ticks, i;
+
+    kstats.timer_irqs++;
+    clock_fold();
+    /* rounded, so a periodic device a little fast or slow still counts 1 */
+    ticks = div_u64(clock_base - tick_last + TICK_NS / 2, TICK_NS);
+    tick_last += (uint64_t)ticks * TICK_NS;
+
+    for (i = 0; i < ticks; i++)
+        wheel_run();
+    if (tick_nohz)
+        timer_arm();
+    if (ticks != 0) {
+        kstats.timer_ticks += ticks;
+        sched_tick(ticks);
+    }
+}
+
+
+/*
+ * tick_update
+ * DESCRIPTION: called by the scheduler with interrupts off whenever it
+ *              picked a process. With more than one runnable process the
+ *              quanta need the periodic tick; with one or none the device
+ *              only has to fire for the next event. Devices that can only
+ *              tick periodically keep ticking, and so does every device
+ *              once there are other processors: they tick off the boot
+ *              processor's clock and can't rearm it.
+ * INPUTS: runnable - how many processes are ready to run
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: may reprogram the clock event device
+ */
+void tick_update(uint32_t runnable) {
+    uint32_t nohz = (runnable <= 1 && smp_cpus == 1);
+
+    if (clock_event == NULL || clock_event->oneshot == NULL || nohz == tick_nohz)
+        return;
+    tick_nohz = nohz;
+    if (nohz)
+        timer_arm();
+    else
+        clock_event->periodic();
+}
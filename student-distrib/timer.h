@@ -0,0 +1,115 @@
+/* timer.h - Clock sources, clock event devices and the kernel's clock
+ * vim:ts=4 sw=4 noexpandtab
+ */
+
+#ifndef _TIMER_H
+#define _TIMER_H
+
+#include "types.h"
+
+#define NSEC_PER_SEC 1000000000
+#define TICK_RATE 100                       /* scheduler ticks per second */
+#define TICK_NS (NSEC_PER_SEC / TICK_RATE)
+#define TIMER_MAX_NS 1000000000             /* longest a one-shot is armed for */
+#define TIMER_CAL_NS 10000000               /* how long devices are timed against the clock */
+
+/* Kernel timers hang off a hierarchical wheel: WHEEL_LEVELS levels of
+ * WHEEL_SIZE slots, each slot of level n covering WHEEL_SIZE^n ticks.
+ * Adding and cancelling are O(1); a timer moves down a level (cascades)
+ * at most WHEEL_LEVELS - 1 times before it fires. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_MAX_TICKS ((1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1)    /* about 46 hours */
+
+/* A timer. fn(data) runs in the timer interrupt, with interrupts off. */
+struct ktimer {
+    struct ktimer* next;                    /* NULL while not pending */
+    struct ktimer* prev;
+    uint32_t expires;                       /* tick it fires on */
+    void (*fn)(void* data);
+    void* data;
+};
+
+/* Clocks for clock_gettime */
+#define CLOCK_MONOTONIC 0
+
+struct timespec {
+    uint32_t sec;
+    uint32_t nsec;
+};
+
+/* The clock as published read-only to every process (at TIME_PAGE_USER).
+ * While the clock runs on the TSC a program can read it without a system
+ * call: time = sec/nsec + ((rdtsc - tsc_last) * mult) >> shift, retried
+ * while seq is odd or changed in between. */
+struct time_page {
+    volatile uint32_t seq;                  /* odd while the kernel updates the rest */
+    uint32_t tsc_valid;                     /* 1 if the clock source is the TSC */
+    uint32_t tsc_hz;                        /* calibrated TSC rate, 0 if it couldn't be */
+    uint32_t mult;
+    uint32_t shift;
+    uint64_t tsc_last;
+    uint32_t sec;                           /* time at tsc_last */
+    uint32_t nsec;
+} __attribute__((packed));
+
+/* A free-running counter the kernel's clock is read from. probe finds
+ * (and calibrates) the device and fills in freq; read may be called with
+ * interrupts off. The best rated one that probes is used. */
+struct clocksource {
+    const char* name;
+    uint32_t rating;
+    int32_t (*probe)(void);                 /* 0 if the device is there */
+    uint64_t (*read)(void);
+    uint64_t mask;                          /* counter bits that are valid, it wraps after that */
+    uint32_t freq;                          /* counts per second, set by probe */
+    /* filled in by the timer code */
+    uint32_t mult;                          /* ns = (counts * mult) >> shift */
+    uint32_t shift;
+    uint32_t max_ns;                        /* longest it may go unread without wrapping */
+};
+
+/* A device that interrupts at a time we ask for: every tick (periodic)
+ * or once after ns (oneshot, NULL if it can't). Its interrupt handler
+ * calls timer_interrupt when it is the one in use. */
+struct clock_event {
+    const char* name;
+    uint32_t rating;
+    int32_t irq;                            /* PIC line it raises, -1 if it has its own vector */
+    uint32_t max_ns;                        /* longest oneshot it can do */
+    int32_t (*probe)(void);                 /* 0 if the device is there */
+    void (*periodic)(void);                 /* interrupt every TICK_NS */
+    void (*oneshot)(uint32_t ns);           /* one interrupt ns from now */
+};
+
+/* Externally visible variables */
+/* the clock event device in use, NULL before timer_init */
+extern struct clock_event* clock_event;
+
+/* Drivers, in pit.c, rtc.c, hpet.c and lapic.c */
+extern struct clocksource pit_clocksource;
+extern struct clocksource hpet_clocksource;
+extern struct clock_event pit_clock_event;
+extern struct clock_event rtc_clock_event;
+extern struct clock_event hpet_clock_event;
+extern struct clock_event lapic_clock_event;
+
+/* Externally visible functions */
+/* picks the clock source and clock event device and starts ticking */
+void timer_init(void);
+/* nanoseconds since timer_init, never goes back */
+uint64_t clock_ns(void);
+/* the clock as seconds and nanoseconds */
+void clock_timespec(struct timespec* ts);
+/* runs t->fn(t->data) on the ticks-th tick from now (at least 1) */
+void ktimer_add(struct ktimer* t, uint32_t ticks);
+/* cancels t, returns 1 if it was pending */
+int32_t ktimer_del(struct ktimer* t);
+/* called by the clock event device's interrupt handler */
+void timer_interrupt(void);
+/* picks periodic or one-shot ticks for that many runnable processes */
+void tick_update(uint32_t runnable);
+
+#endif /* _TIMER_H */
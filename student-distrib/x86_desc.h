@@ -15,6 +15,10 @@
 #define USER_DS     0x002B
 #define KERNEL_TSS  0x0030
 #define KERNEL_LDT  0x0038
+#define AP_TSS(cpu) (KERNEL_LDT + 8 * (cpu))    /* TSS of the other processors, cpu >= 1 */
+
+/* Processors the kernel runs on at most, the boot one included */
+#define MAX_CPUS    4
 
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
@@ -122,6 +126,7 @@ extern uint32_t ldt;
 
 extern uint32_t tss_size;
 extern seg_desc_t tss_desc_ptr;
+extern seg_desc_t ap_tss_desc_ptr[MAX_CPUS - 1];
 extern tss_t tss;
 
 /* Sets runtime-settable parameters in the GDT entry for the LDT */
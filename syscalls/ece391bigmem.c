@@ -0,0 +1,55 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NBUFSIZE 12
+#define BIG_LEN (8 * 1024 * 1024)
+#define STRIDE 4096
+
+static void
+put_stat (const char* name, uint32_t value, int32_t base)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (value, num, base));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/*
+ * Maps 8MB of anonymous memory, writes a pattern into every page and
+ * reads it back. On a machine with RAM above 4GB the kernel backs the
+ * mapping with 4MB pages from there; otherwise it falls back to 4KB
+ * pages from the low pool and the high counters stay zero.
+ */
+int main ()
+{
+    uint32_t* mem;
+    ece391_kstats_t ks;
+    uint32_t i;
+
+    mem = ece391_mmap (-1, BIG_LEN, PROT_READ | PROT_WRITE);
+    if ((void*)-1 == mem) {
+        ece391_fdputs (1, (uint8_t*)"mmap failed\n");
+        return 3;
+    }
+
+    for (i = 0; i < BIG_LEN / sizeof (uint32_t); i += STRIDE / sizeof (uint32_t))
+        mem[i] = i ^ 0x5A5A5A5A;
+    for (i = 0; i < BIG_LEN / sizeof (uint32_t); i += STRIDE / sizeof (uint32_t)) {
+        if (mem[i] != (i ^ 0x5A5A5A5A)) {
+            ece391_fdputs (1, (uint8_t*)"bad readback\n");
+            return 3;
+        }
+    }
+
+    if (sizeof (ks) != ece391_kstat (&ks, sizeof (ks))) {
+        ece391_fdputs (1, (uint8_t*)"kstat failed\n");
+        return 3;
+    }
+    put_stat ("mapped at 0x", (uint32_t)mem, 16);
+    put_stat ("4MB chunks above 4GB: ", ks.high_chunks, 10);
+    put_stat ("...in use: ", ks.high_used, 10);
+    return 0;
+}
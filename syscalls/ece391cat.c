@@ -5,8 +5,9 @@
 
 int main ()
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, left;
     uint8_t buf[1024];
+    ece391_stat_t st;
 
     if (0 != ece391_getargs (buf, 1024)) {
         ece391_fdputs (1, (uint8_t*)"could not read arguments\n");
@@ -18,13 +19,18 @@ int main ()
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, 1024))) {
+    /* for regular files the size is known, so skip the final zero-length read */
+    left = (0 == ece391_fstat (fd, &st) && 2 == st.type) ? st.size : -1;
+
+    while (0 != left && 0 != (cnt = ece391_read (fd, buf, 1024))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
 	    return 3;
 	}
 	if (-1 == ece391_write (1, buf, cnt))
 	    return 3;
+	if (left > 0)
+	    left -= cnt;
     }
 
     return 0;
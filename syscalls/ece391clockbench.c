@@ -0,0 +1,53 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NBUFSIZE 12
+#define CALLS 10000
+
+static void
+put_stat (const char* name, uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* microseconds from a to b, good for an hour */
+static uint32_t
+elapsed_us (ece391_timespec_t* a, ece391_timespec_t* b)
+{
+    return (b->sec - a->sec) * 1000000 + b->nsec / 1000 - a->nsec / 1000;
+}
+
+/*
+ * Prints the time since boot and how long it takes to read the clock,
+ * with the clock_gettime system call and from the time page.
+ */
+int main ()
+{
+    ece391_timespec_t start, end, ts;
+    uint32_t i;
+
+    if (-1 == ece391_clock_gettime (CLOCK_MONOTONIC, &ts))
+        return 3;
+    put_stat ("seconds since boot: ", ts.sec);
+    put_stat ("tsc hz: ", ECE391_TIME_PAGE->tsc_hz);
+    put_stat ("time page usable: ", ECE391_TIME_PAGE->tsc_valid);
+
+    ece391_clock (&start);
+    for (i = 0; i < CALLS; i++)
+        ece391_clock_gettime (CLOCK_MONOTONIC, &ts);
+    ece391_clock (&end);
+    put_stat ("ns per clock_gettime: ", elapsed_us (&start, &end) * 1000 / CALLS);
+
+    ece391_clock (&start);
+    for (i = 0; i < CALLS; i++)
+        ece391_clock (&ts);
+    ece391_clock (&end);
+    put_stat ("ns per time page read: ", elapsed_us (&start, &end) * 1000 / CALLS);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define NBUFSIZE 12
+#define LINES 10
+#define HOG_TICKS 6000          /* a minute at 100 ticks per second */
+#define HOG_CHECK 1000000       /* spins between looks at the clock */
+
+static void
+put_stat (const char* name, uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* burns the CPU for about a minute, never blocking */
+static int
+hog (void)
+{
+    ece391_kstats_t ks;
+    uint32_t start;
+    volatile uint32_t i;
+
+    if (sizeof (ks) != ece391_kstat (&ks, sizeof (ks)))
+        return 3;
+    start = ks.timer_ticks;
+    do {
+        for (i = 0; i < HOG_CHECK; i++);
+        if (sizeof (ks) != ece391_kstat (&ks, sizeof (ks)))
+            return 3;
+    } while (ks.timer_ticks - start < HOG_TICKS);
+    return 0;
+}
+
+/*
+ * Measures how long it takes from pressing enter until the program
+ * reading the line runs again, for LINES lines.  Start "echolat hog"
+ * (or "echolat hog 19" to run it niced) on the other terminals first
+ * to see how the scheduler keeps an interactive program responsive
+ * next to CPU hogs.
+ */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    ece391_kstats_t before, after;
+    uint32_t i, lat, total = 0, max = 0, n = 0;
+    int32_t nice = 0;
+
+    if (0 == ece391_getargs (buf, BUFSIZE) && 0 == ece391_strncmp (buf, (uint8_t*)"hog", 3)) {
+        for (i = 3; ' ' == buf[i]; i++);
+        for (; buf[i] >= '0' && buf[i] <= '9'; i++)
+            nice = nice * 10 + buf[i] - '0';
+        ece391_nice (nice);
+        return hog ();
+    }
+
+    ece391_fdputs (1, (uint8_t*)"press enter a few times\n");
+    for (i = 0; i < LINES; i++) {
+        if (sizeof (before) != ece391_kstat (&before, sizeof (before)))
+            return 3;
+        if (-1 == ece391_read (0, buf, BUFSIZE))
+            return 3;
+        if (sizeof (after) != ece391_kstat (&after, sizeof (after)))
+            return 3;
+        if (after.echo_lines - before.echo_lines != 1)
+            continue;       /* the line was typed before we asked for it */
+        lat = after.echo_cycles - before.echo_cycles;
+        put_stat ("enter to reader, cycles: ", lat);
+        total += lat;
+        if (lat > max)
+            max = lat;
+        n++;
+    }
+    if (0 != n)
+        put_stat ("average: ", total / n);
+    put_stat ("worst: ", max);
+    return 0;
+}
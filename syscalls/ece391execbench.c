@@ -0,0 +1,59 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define NBUFSIZE 12
+#define LAUNCHES 10
+
+static void
+put_stat (const char* name, uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/*
+ * Launches a program (testprint unless one is given) several times and
+ * reports how many cycles the kernel spent loading it.  The first launch
+ * reads the executable; the rest should come from the image cache.
+ */
+int main ()
+{
+    uint8_t cmd[BUFSIZE];
+    ece391_kstats_t before, after, start;
+    uint32_t i, first = 0, rest = 0;
+
+    if (0 != ece391_getargs (cmd, BUFSIZE) || '\0' == cmd[0])
+        ece391_strcpy (cmd, (uint8_t*)"testprint");
+
+    if (sizeof (start) != ece391_kstat (&start, sizeof (start))) {
+        ece391_fdputs (1, (uint8_t*)"kstat failed\n");
+        return 3;
+    }
+
+    for (i = 0; i < LAUNCHES; i++) {
+        ece391_kstat (&before, sizeof (before));
+        if (-1 == ece391_execute (cmd)) {
+            ece391_fdputs (1, (uint8_t*)"execute failed\n");
+            return 3;
+        }
+        ece391_kstat (&after, sizeof (after));
+        if (0 == i)
+            first = after.exec_cycles - before.exec_cycles;
+        else
+            rest += after.exec_cycles - before.exec_cycles;
+    }
+
+    put_stat ("launches: ", LAUNCHES);
+    put_stat ("cache hits: ", after.exec_hits - start.exec_hits);
+    put_stat ("cache misses: ", after.exec_misses - start.exec_misses);
+    put_stat ("first load cycles: ", first);
+    put_stat ("average later load cycles: ", rest / (LAUNCHES - 1));
+
+    return 0;
+}
@@ -5,58 +5,93 @@
 
 #define BUFSIZE 1024
 #define SBUFSIZE 33
+#define NENTS 32
 
-int32_t
-do_one_file (const char* s, const char* fname) 
+static void
+grep_line (const char* s, int32_t s_len, const char* fname,
+	   const uint8_t* line, int32_t len)
 {
-    int32_t fd, cnt, last, line_start, line_end, check, s_len;
-    uint8_t data[BUFSIZE+1];
+    int32_t check;
 
-    s_len = ece391_strlen ((uint8_t*)s);
-    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
-        ece391_fdputs (1, (uint8_t*)"file open failed\n");
-        return -1;
+    for (check = 0; check + s_len <= len; check++) {
+	if (s[0] == line[check] && 
+	    0 == ece391_strncmp ((uint8_t*)(line + check), (uint8_t*)s, s_len)) {
+	    ece391_fdputs (1, (uint8_t*)fname);
+	    ece391_fdputs (1, (uint8_t*)":");
+	    (void)ece391_write (1, line, len);
+	    ece391_fdputs (1, (uint8_t*)"\n");
+	    return;
+	}
     }
+}
+
+/* copies the file in a buffer at a time, for when it can't be mapped */
+static int32_t
+grep_read (const char* s, int32_t s_len, const char* fname, int32_t fd)
+{
+    int32_t cnt, last, line_start, line_end, i;
+    uint8_t data[BUFSIZE];
+
     last = 0;
-    while (1) {
+    do {
         cnt = ece391_read (fd, data + last, BUFSIZE - last);
 	if (-1 == cnt) {
-            ece391_fdputs (1, (uint8_t*)"file read failed\n");
-            return -1;
+	    ece391_fdputs (1, (uint8_t*)"file read failed\n");
+	    return -1;
 	}
 	last += cnt;
-	line_start = 0;
-	while (1) {
+	for (line_start = 0; ; line_start = line_end + 1) {
 	    line_end = line_start;
 	    while (line_end < last && '\n' != data[line_end])
 		line_end++;
-	    if ('\n' != data[line_end] && 0 != cnt && line_start != 0) {
-		/* copy from line_start to last down to 0 and fix last */
-		data[line_end] = '\0';
-		ece391_strcpy (data, data + line_start);
+	    /* keep a partial line for the next read, unless it fills the buffer */
+	    if (line_end == last && 0 != cnt &&
+		(0 != line_start || BUFSIZE != last)) {
+		for (i = line_start; i < last; i++)
+		    data[i - line_start] = data[i];
 		last -= line_start;
 		break;
 	    }
-	    /* search the line */
-	    data[line_end] = '\0';
-	    for (check = line_start; check < line_end; check++) {
-		if (s[0] == data[check] && 
-		    0 == ece391_strncmp ((uint8_t*)(data + check), (uint8_t*)s, s_len)) {
-		    ece391_fdputs (1, (uint8_t*)fname);
-		    ece391_fdputs (1, (uint8_t*)":");
-		    ece391_fdputs (1, data + line_start);
-		    ece391_fdputs (1, (uint8_t*)"\n");
-		    break;
-		}
-	    }
-	    line_start = line_end + 1;
-	    if (line_start >= last) {
-	        last = 0;
+	    if (line_start < last)
+		grep_line (s, s_len, fname, data + line_start, line_end - line_start);
+	    if (line_end >= last) {
+		last = 0;
 		break;
 	    }
 	}
-	if (0 == cnt)
-	    break;
+    } while (0 != cnt);
+    return 0;
+}
+
+int32_t
+do_one_file (const char* s, const char* fname) 
+{
+    int32_t fd, line_start, line_end, s_len;
+    ece391_stat_t st;
+    uint8_t* data;
+
+    s_len = ece391_strlen ((uint8_t*)s);
+    if (-1 == (fd = ece391_open ((uint8_t*)fname))) {
+        ece391_fdputs (1, (uint8_t*)"file open failed\n");
+        return -1;
+    }
+    if (-1 == ece391_fstat (fd, &st)) {
+        ece391_fdputs (1, (uint8_t*)"file stat failed\n");
+        return -1;
+    }
+    /* scan the file where it sits in memory instead of copying it in */
+    if (0 == st.size ||
+	(uint8_t*)-1 == (data = ece391_mmap (fd, 0, PROT_READ))) {
+	if (0 != grep_read (s, s_len, fname, fd))
+	    return -1;
+    } else {
+	for (line_start = 0; line_start < st.size; line_start = line_end + 1) {
+	    line_end = line_start;
+	    while (line_end < st.size && '\n' != data[line_end])
+		line_end++;
+	    grep_line (s, s_len, fname, data + line_start, line_end - line_start);
+	}
+	(void)ece391_munmap (data, st.size);
     }
     if (-1 == ece391_close (fd)) {
         ece391_fdputs (1, (uint8_t*)"file close failed\n");
@@ -67,7 +102,8 @@ do_one_file (const char* s, const char* fname)
 
 int main ()
 {
-    int32_t fd, cnt;
+    int32_t fd, cnt, i, j;
+    ece391_dirent_t ents[NENTS];
     uint8_t buf[SBUFSIZE];
     uint8_t search[BUFSIZE];
 
@@ -81,16 +117,21 @@ int main ()
 	return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	    ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	    return 3;
 	}
-	if ('.' == buf[0]) /* a directory... */
-	    continue;
-	buf[cnt] = '\0';
-	if (0 != do_one_file ((char*)search, (char*)buf))
-	    return 3;
+	cnt /= sizeof (ece391_dirent_t);
+	for (i = 0; i < cnt; i++) {
+	    if (2 != ents[i].type) /* only search regular files */
+		continue;
+	    for (j = 0; j < SBUFSIZE - 1 && '\0' != ents[i].name[j]; j++)
+		buf[j] = ents[i].name[j];
+	    buf[j] = '\0';
+	    if (0 != do_one_file ((char*)search, (char*)buf))
+		return 3;
+	}
     }
 
     return 0;
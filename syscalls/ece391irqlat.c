@@ -0,0 +1,63 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NBUFSIZE 12
+#define LINE_LEN 64
+#define LINES 400
+#define LOADS 5
+
+static void
+put_stat (const char* name, uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* worst RTC tick delay the kernel has seen so far, 0 on error */
+static uint32_t
+worst_latency (void)
+{
+    ece391_kstats_t ks;
+
+    if (sizeof (ks) != ece391_kstat (&ks, sizeof (ks)))
+        return 0;
+    return ks.irq_lat_max;
+}
+
+/*
+ * Runs the kernel paths that used to keep interrupts off for a long
+ * time, one large write to the terminal and a few program loads, and
+ * reports the worst interrupt latency the RTC saw before and after.
+ * Leave the RTC running at 1024Hz so there are ticks to time.
+ */
+int main ()
+{
+    uint8_t buf[LINE_LEN * LINES];
+    uint32_t i, before, after;
+
+    before = worst_latency ();
+
+    for (i = 0; i < LINE_LEN * LINES; i++)
+        buf[i] = (LINE_LEN - 1 == i % LINE_LEN) ? '\n' : 'a' + i % 26;
+    if (-1 == ece391_write (1, buf, LINE_LEN * LINES)) {
+        ece391_fdputs (1, (uint8_t*)"write failed\n");
+        return 3;
+    }
+    after = worst_latency ();
+    put_stat ("worst latency before, cycles: ", before);
+    put_stat ("...after a large write: ", after);
+
+    for (i = 0; i < LOADS; i++) {
+        if (-1 == ece391_execute ((uint8_t*)"testprint")) {
+            ece391_fdputs (1, (uint8_t*)"execute failed\n");
+            return 3;
+        }
+    }
+    put_stat ("...after loading programs: ", worst_latency ());
+    return 0;
+}
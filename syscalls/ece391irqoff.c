@@ -0,0 +1,66 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NBUFSIZE 12
+
+static void
+put_num (uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+}
+
+/*
+ * Prints how long the kernel has kept interrupts disabled since boot:
+ * a histogram of window lengths in cycles, then the places in the
+ * kernel that held them off the longest.  Run it after reproducing an
+ * input-lag spike to see where it came from.
+ */
+int main ()
+{
+    ece391_irqoff_t st;
+    uint32_t i;
+
+    if (sizeof (st) != ece391_irqoff (&st, sizeof (st))) {
+        ece391_fdputs (1, (uint8_t*)"irqoff failed\n");
+        return 3;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"windows: ");
+    put_num (st.windows);
+    ece391_fdputs (1, (uint8_t*)", longest cycles: ");
+    put_num (st.max);
+    ece391_fdputs (1, (uint8_t*)"\n");
+
+    for (i = 0; i < IRQOFF_BUCKETS; i++) {
+        if (0 == st.hist[i])
+            continue;
+        if (IRQOFF_BUCKETS - 1 == i) {
+            ece391_fdputs (1, (uint8_t*)"  >=");
+            put_num (1 << (IRQOFF_SHIFT + i - 1));
+        } else {
+            ece391_fdputs (1, (uint8_t*)"  <");
+            put_num (1 << (IRQOFF_SHIFT + i));
+        }
+        ece391_fdputs (1, (uint8_t*)": ");
+        put_num (st.hist[i]);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+
+    ece391_fdputs (1, (uint8_t*)"longest by site:\n");
+    for (i = 0; i < IRQOFF_SITES; i++) {
+        if (0 == st.sites[i].cycles)
+            continue;
+        ece391_fdputs (1, (uint8_t*)"  ");
+        ece391_fdputs (1, (uint8_t*)st.sites[i].file);
+        ece391_fdputs (1, (uint8_t*)":");
+        put_num (st.sites[i].line);
+        ece391_fdputs (1, (uint8_t*)" ");
+        put_num (st.sites[i].cycles);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define NBUFSIZE 12
+#define TICK_RATE 100           /* timer ticks per second */
+
+static void
+put_stat (const char* name, uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/*
+ * Counts the timer and RTC interrupts that come in while the machine
+ * sits idle between two presses of enter, and prints them per second.
+ * The kernel keeps counting time in timer ticks even when the timer
+ * only fires once in a while, so ticks are the clock here.
+ */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    ece391_kstats_t before, after;
+    uint32_t secs, pit, rtc;
+
+    ece391_fdputs (1, (uint8_t*)"press enter to start, wait, then enter to stop\n");
+    if (-1 == ece391_read (0, buf, BUFSIZE))
+        return 3;
+    if (sizeof (before) != ece391_kstat (&before, sizeof (before)))
+        return 3;
+    if (-1 == ece391_read (0, buf, BUFSIZE))
+        return 3;
+    if (sizeof (after) != ece391_kstat (&after, sizeof (after)))
+        return 3;
+
+    secs = (after.timer_ticks - before.timer_ticks) / TICK_RATE;
+    if (0 == secs) {
+        ece391_fdputs (1, (uint8_t*)"wait at least a second\n");
+        return 2;
+    }
+    pit = after.timer_irqs - before.timer_irqs;
+    rtc = after.rtc_irqs - before.rtc_irqs;
+    put_stat ("seconds: ", secs);
+    put_stat ("timer interrupts per second: ", pit / secs);
+    put_stat ("rtc interrupts per second: ", rtc / secs);
+    put_stat ("total per second: ", (pit + rtc) / secs);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NBUFSIZE 12
+
+static void
+put_num (uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+}
+
+/*
+ * Prints each interrupt vector the kernel registered a handler on: how
+ * many interrupts came in, and a histogram of the cycles from entering
+ * the kernel to the EOI, which is how long the interrupt controller
+ * held that line back.
+ */
+int main ()
+{
+    ece391_irqstat_t st;
+    ece391_irq_vec_t* v;
+    uint32_t i, b;
+
+    if (sizeof (st) != ece391_irqstat (&st, sizeof (st))) {
+        ece391_fdputs (1, (uint8_t*)"irqstat failed\n");
+        return 3;
+    }
+
+    for (i = 0; i < st.nvec; i++) {
+        v = &st.vec[i];
+        ece391_fdputs (1, (uint8_t*)"vector ");
+        put_num (v->vector);
+        ece391_fdputs (1, (uint8_t*)" ");
+        ece391_fdputs (1, (uint8_t*)v->name);
+        ece391_fdputs (1, (uint8_t*)": ");
+        put_num (v->count);
+        ece391_fdputs (1, (uint8_t*)", longest cycles: ");
+        put_num (v->max);
+        ece391_fdputs (1, (uint8_t*)"\n");
+
+        for (b = 0; b < IRQ_LAT_BUCKETS; b++) {
+            if (0 == v->hist[b])
+                continue;
+            if (IRQ_LAT_BUCKETS - 1 == b) {
+                ece391_fdputs (1, (uint8_t*)"  >=");
+                put_num (1 << (IRQ_LAT_SHIFT + b - 1));
+            } else {
+                ece391_fdputs (1, (uint8_t*)"  <");
+                put_num (1 << (IRQ_LAT_SHIFT + b));
+            }
+            ece391_fdputs (1, (uint8_t*)": ");
+            put_num (v->hist[b]);
+            ece391_fdputs (1, (uint8_t*)"\n");
+        }
+    }
+    return 0;
+}
@@ -3,26 +3,41 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
-#define SBUFSIZE 33
+#define NAMELEN 32
+#define NENTS 32
+#define LBUFSIZE 64
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, i, len;
+    ece391_dirent_t ents[NENTS];
+    uint8_t line[LBUFSIZE];
 
     if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+    /* each call returns as many entries as fit in ents */
+    while (0 != (cnt = ece391_getdents (fd, ents, sizeof (ents)))) {
         if (-1 == cnt) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
-	        return 3;
+	    cnt /= sizeof (ece391_dirent_t);
+	    for (i = 0; i < cnt; i++) {
+	        for (len = 0; len < NAMELEN && '\0' != ents[i].name[len]; len++)
+		    line[len] = ents[i].name[len];
+		while (len <= NAMELEN)
+		    line[len++] = ' ';
+		line[len++] = '0' + ents[i].type;
+		line[len++] = ' ';
+		ece391_itoa (ents[i].size, line + len, 10);
+		len += ece391_strlen (line + len);
+		line[len++] = '\n';
+		if (-1 == ece391_write (1, line, len))
+		    return 3;
+	    }
     }
 
     return 0;
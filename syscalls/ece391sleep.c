@@ -0,0 +1,43 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 32
+#define NBUFSIZE 12
+
+/*
+ * sleep N sleeps N seconds, sleep Nms N milliseconds, and then prints
+ * how long it was really gone for.
+ */
+int main ()
+{
+    uint8_t buf[BUFSIZE];
+    uint8_t num[NBUFSIZE];
+    ece391_timespec_t req, start, end;
+    uint32_t n = 0, i, ms;
+
+    if (0 != ece391_getargs (buf, BUFSIZE) || buf[0] < '0' || buf[0] > '9') {
+        ece391_fdputs (1, (uint8_t*)"usage: sleep seconds, or sleep millisecondsms\n");
+        return 3;
+    }
+    for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+        n = n * 10 + buf[i] - '0';
+
+    ece391_clock (&start);
+    if (0 == ece391_strcmp (buf + i, (uint8_t*)"ms")) {
+        req.sec = n / 1000;
+        req.nsec = (n % 1000) * 1000000;
+        if (0 != ece391_nanosleep (&req))
+            return 2;
+    } else if (0 != ece391_sleep (n)) {
+        return 2;
+    }
+    ece391_clock (&end);
+
+    ms = (end.sec - start.sec) * 1000 + end.nsec / 1000000 - start.nsec / 1000000;
+    ece391_fdputs (1, (uint8_t*)"slept ");
+    ece391_fdputs (1, ece391_itoa (ms, num, 10));
+    ece391_fdputs (1, (uint8_t*)"ms\n");
+    return 0;
+}
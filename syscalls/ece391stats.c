@@ -0,0 +1,86 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NBUFSIZE 12
+
+static void
+put_stat (const char* name, uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* hits per hundred, 0 if nothing was counted */
+static uint32_t
+percent (uint32_t part, uint32_t whole)
+{
+    return (0 == whole ? 0 : part * 100 / whole);
+}
+
+int main ()
+{
+    ece391_kstats_t ks;
+
+    if (sizeof (ks) != ece391_kstat (&ks, sizeof (ks))) {
+        ece391_fdputs (1, (uint8_t*)"kstat failed\n");
+        return 3;
+    }
+
+    put_stat ("readahead sequential reads: ", ks.ra_reads);
+    put_stat ("readahead hits: ", ks.ra_hits);
+    put_stat ("readahead hit %: ", percent (ks.ra_hits, ks.ra_reads));
+    put_stat ("readahead blocks: ", ks.ra_blocks);
+    put_stat ("exec loads: ", ks.exec_loads);
+    put_stat ("exec cache hits: ", ks.exec_hits);
+    put_stat ("exec cache misses: ", ks.exec_misses);
+    put_stat ("exec cache evictions: ", ks.exec_evicts);
+    put_stat ("exec shared pages: ", ks.exec_shared);
+    put_stat ("copy-on-write copies: ", ks.cow_copies);
+    put_stat ("TLB flushes: ", ks.tlb_flushes);
+    put_stat ("TLB single-page invalidations: ", ks.tlb_pages);
+    put_stat ("terminal scrolls: ", ks.scrolls);
+    put_stat ("pre-zeroed pool depth: ", ks.zero_depth);
+    put_stat ("frames zeroed while idle: ", ks.zero_filled);
+    put_stat ("zeroed frames from the pool: ", ks.zero_hits);
+    put_stat ("zeroed frames with the pool empty: ", ks.zero_empty);
+    put_stat ("pre-zeroed pool hit %: ", percent (ks.zero_hits, ks.zero_hits + ks.zero_empty));
+    put_stat ("pre-zeroed frames spent out of memory: ", ks.zero_spent);
+    put_stat ("pages swapped out: ", ks.swap_outs);
+    put_stat ("pages swapped in: ", ks.swap_ins);
+    put_stat ("pages in swap: ", ks.swap_pages);
+    put_stat ("incompressible pages: ", ks.swap_rejects);
+    if (ks.swap_stored >= 100)
+        put_stat ("swap compression ratio x100: ",
+                  ks.swap_outs * 4096 / (ks.swap_stored / 100));
+    if (0 != ks.swap_ins)
+        put_stat ("average swap-in cycles: ", ks.swap_in_cycles / ks.swap_ins);
+    put_stat ("4MB chunks above 4GB: ", ks.high_chunks);
+    put_stat ("...in use: ", ks.high_used);
+    put_stat ("interrupt latency samples: ", ks.irq_lat_samples);
+    put_stat ("worst interrupt latency cycles: ", ks.irq_lat_max);
+    put_stat ("deferred reschedules: ", ks.preempt_deferred);
+    put_stat ("timer ticks: ", ks.timer_ticks);
+    put_stat ("context switches: ", ks.ctx_switches);
+    put_stat ("scheduler demotions: ", ks.sched_demotions);
+    put_stat ("scheduler wakeups: ", ks.sched_wakeups);
+    put_stat ("scheduler boosts: ", ks.sched_boosts);
+    put_stat ("lines read: ", ks.echo_lines);
+    if (0 != ks.echo_lines)
+        put_stat ("average enter-to-reader cycles: ", ks.echo_cycles / ks.echo_lines);
+    put_stat ("worst enter-to-reader cycles: ", ks.echo_max);
+    put_stat ("timer interrupts: ", ks.timer_irqs);
+    put_stat ("one-shot timer interrupts: ", ks.timer_oneshots);
+    put_stat ("rtc interrupts: ", ks.rtc_irqs);
+    put_stat ("kernel timers fired: ", ks.ktimers_fired);
+    put_stat ("timer wheel cascades: ", ks.ktimer_cascades);
+    put_stat ("processors online: ", ks.cpus);
+    put_stat ("run queue steals: ", ks.sched_steals);
+    put_stat ("kernel lock waits: ", ks.kernel_lock_waits);
+
+    return 0;
+}
@@ -102,3 +102,137 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+
+/*
+ * Heap allocator on top of sbrk.  Small blocks come in power-of-two
+ * size classes from 16 to 2048 bytes (header included), each class
+ * with its own free list refilled a page at a time.  Bigger blocks are
+ * whole pages and go on one list of their own when freed, reused by
+ * the first one that is big enough.
+ */
+#define HEAP_HDR 8              /* keeps the payload 8-byte aligned */
+#define HEAP_MIN_SHIFT 4        /* smallest class is 16 bytes */
+#define HEAP_CLASSES 8          /* 16, 32, ... 2048 */
+#define HEAP_PAGE 4096
+#define HEAP_MAX 0x7FFFFFFF      /* most sbrk can grow by, it takes an int32_t */
+
+typedef struct heap_block {
+    uint32_t size;              /* whole block, header included */
+    uint32_t pad;
+    struct heap_block* next;    /* only while on a free list, in the payload */
+} heap_block_t;
+
+static heap_block_t* heap_free[HEAP_CLASSES];
+static heap_block_t* heap_large;
+
+/* carves a fresh page into blocks of one class */
+static int32_t heap_refill(int32_t cls)
+{
+    uint32_t size = 1 << (cls + HEAP_MIN_SHIFT);
+    uint8_t* page = ece391_sbrk (HEAP_PAGE);
+    uint32_t off;
+    heap_block_t* b;
+
+    if ((void*)-1 == page)
+        return -1;
+    for (off = 0; off + size <= HEAP_PAGE; off += size) {
+        b = (heap_block_t*)(page + off);
+        b->size = size;
+        b->next = heap_free[cls];
+        heap_free[cls] = b;
+    }
+    return 0;
+}
+
+void* ece391_malloc(uint32_t size)
+{
+    uint32_t total = size + HEAP_HDR;
+    heap_block_t *b, **prev;
+    int32_t cls;
+
+    if (0 == size || total < size)
+        return (void*)0;
+
+    for (cls = 0; cls < HEAP_CLASSES; cls++) {
+        if (total <= (1U << (cls + HEAP_MIN_SHIFT))) {
+            if (0 == heap_free[cls] && 0 != heap_refill (cls))
+                return (void*)0;
+            b = heap_free[cls];
+            heap_free[cls] = b->next;
+            return (uint8_t*)b + HEAP_HDR;
+        }
+    }
+
+    total = (total + HEAP_PAGE - 1) & ~(HEAP_PAGE - 1);
+    if (total < size || total > HEAP_MAX)
+        return (void*)0;    /* wrapped, or too big for sbrk */
+    for (prev = &heap_large; 0 != *prev; prev = &(*prev)->next) {
+        if ((*prev)->size >= total) {
+            b = *prev;
+            *prev = b->next;
+            return (uint8_t*)b + HEAP_HDR;
+        }
+    }
+    if ((void*)-1 == (b = ece391_sbrk (total)))
+        return (void*)0;
+    b->size = total;
+    return (uint8_t*)b + HEAP_HDR;
+}
+
+void ece391_free(void* ptr)
+{
+    heap_block_t* b;
+    int32_t cls;
+
+    if (0 == ptr)
+        return;
+    b = (heap_block_t*)((uint8_t*)ptr - HEAP_HDR);
+    for (cls = 0; cls < HEAP_CLASSES; cls++) {
+        if (b->size == (1U << (cls + HEAP_MIN_SHIFT))) {
+            b->next = heap_free[cls];
+            heap_free[cls] = b;
+            return;
+        }
+    }
+    b->next = heap_large;
+    heap_large = b;
+}
+
+/*
+ * Reads the kernel's clock from the time page, with no system call:
+ * the time of the kernel's last timer interrupt plus the TSC cycles
+ * since, scaled the way the kernel does.  Falls back to clock_gettime
+ * when the kernel's clock isn't the TSC.
+ */
+int32_t ece391_clock(struct ece391_timespec* ts)
+{
+    volatile ece391_time_page_t* tp = ECE391_TIME_PAGE;
+    uint32_t seq, sec, nsec;
+    uint64_t tsc, ns;
+
+    do {
+        seq = tp->seq;
+        asm volatile ("" : : : "memory");
+        if (!tp->tsc_valid)
+            return ece391_clock_gettime (CLOCK_MONOTONIC, ts);
+        sec = tp->sec;
+        nsec = tp->nsec;
+        asm volatile ("rdtsc" : "=A" (tsc));
+        ns = ((tsc - tp->tsc_last) * tp->mult) >> tp->shift;
+        asm volatile ("" : : : "memory");
+    } while ((seq & 1) || seq != tp->seq);
+
+    /* at most a second or so since the kernel's last update */
+    while (ns >= 1000000000) {
+        ns -= 1000000000;
+        sec++;
+    }
+    nsec += (uint32_t)ns;
+    if (nsec >= 1000000000) {
+        nsec -= 1000000000;
+        sec++;
+    }
+    ts->sec = sec;
+    ts->nsec = nsec;
+    return 0;
+}
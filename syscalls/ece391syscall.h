@@ -21,6 +21,219 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_getdents (int32_t fd, void* buf, int32_t nbytes);
+
+/*
+ * Record filled in by getdents.  The name is not NUL-terminated when
+ * all 32 characters are used.  Size is only meaningful for regular
+ * files (type 2).
+ */
+typedef struct ece391_dirent {
+	uint8_t  name[32];
+	uint32_t type;
+	uint32_t inode;
+	uint32_t size;
+} __attribute__((packed)) ece391_dirent_t;
+
+/* File information filled in by stat/fstat. */
+typedef struct ece391_stat {
+	uint32_t type;
+	uint32_t inode;
+	uint32_t size;
+	uint32_t blocks;
+} __attribute__((packed)) ece391_stat_t;
+
+extern int32_t ece391_stat (const uint8_t* filename, ece391_stat_t* buf);
+extern int32_t ece391_fstat (int32_t fd, ece391_stat_t* buf);
+
+/* whence values for lseek */
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+extern int32_t ece391_lseek (int32_t fd, int32_t offset, int32_t whence);
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+
+/*
+ * mmap maps an open file read-only; with PROT_WRITE the mapping is
+ * private and pages are copied on their first write.  With fd -1 it
+ * maps length bytes of zeroed memory instead.  Returns (void*)-1 on
+ * failure.
+ */
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
+
+extern void* ece391_mmap (int32_t fd, uint32_t length, int32_t prot);
+
+/*
+ * munmap unmaps length bytes of 4KB pages that mmap mapped, starting
+ * at the page addr.  Returns 0, or -1 if the range isn't mapped.
+ */
+extern int32_t ece391_munmap (void* addr, uint32_t length);
+
+/*
+ * sbrk moves the end of the heap (which starts right after the
+ * program) by increment bytes and returns the old end, or (void*)-1
+ * if it can't.  ece391_malloc in ece391support.c sits on top of it.
+ */
+extern void* ece391_sbrk (int32_t increment);
+
+/*
+ * nice adds increment to the caller's nice value (0 to 19) and returns
+ * the new one.  Nicer programs are kept on the lower levels of the
+ * scheduler's queue; children inherit the value.
+ */
+extern int32_t ece391_nice (int32_t increment);
+
+/*
+ * Kernel statistics.  Counters only go up; take the difference of two
+ * snapshots.  kstat copies at most sizeof (ece391_kstats_t) bytes and
+ * returns how many it copied.
+ */
+typedef struct ece391_kstats {
+	uint32_t ra_reads;	/* sequential file reads */
+	uint32_t ra_hits;	/* ...whose blocks were already read ahead */
+	uint32_t ra_blocks;	/* blocks read ahead */
+	uint32_t exec_loads;	/* executables loaded by execute */
+	uint32_t exec_hits;	/* ...from a cached image */
+	uint32_t exec_misses;	/* ...that had to be read from the file */
+	uint32_t exec_evicts;	/* cached images dropped */
+	uint32_t exec_cycles;	/* cycles spent loading (low 32 bits) */
+	uint32_t exec_shared;	/* pages mapped from a cached image instead of copied */
+	uint32_t cow_copies;	/* copy-on-write pages that had to be copied */
+	uint32_t tlb_flushes;	/* cr3 loads (address space switches and full flushes) */
+	uint32_t tlb_pages;	/* single pages invalidated with invlpg */
+	uint32_t scrolls;	/* terminal lines scrolled */
+	uint32_t scroll_cycles;	/* cycles spent scrolling (low 32 bits) */
+	uint32_t zero_depth;	/* frames in the pre-zeroed pool now (not a counter) */
+	uint32_t zero_filled;	/* frames zeroed while idle */
+	uint32_t zero_hits;	/* zeroed frames taken from the pool */
+	uint32_t zero_empty;	/* ...or cleared on the spot because it was empty */
+	uint32_t zero_spent;	/* zeroed frames alloc_frame fell back on, out of memory */
+	uint32_t swap_outs;	/* pages compressed into swap */
+	uint32_t swap_stored;	/* ...and the compressed bytes they took */
+	uint32_t swap_rejects;	/* pages that didn't compress well enough */
+	uint32_t swap_ins;	/* pages decompressed on a fault */
+	uint32_t swap_in_cycles;	/* cycles spent decompressing (low 32 bits) */
+	uint32_t swap_pages;	/* pages in swap now (not a counter) */
+	uint32_t high_chunks;	/* 4MB chunks found above 4GB (not a counter) */
+	uint32_t high_used;	/* ...mapped by processes now (not a counter) */
+	uint32_t irq_lat_samples;	/* RTC ticks timed for interrupt latency */
+	uint32_t irq_lat_max;	/* worst cycles a tick was held up (not a counter) */
+	uint32_t preempt_deferred;	/* reschedules put off until preempt_enable */
+	uint32_t timer_ticks;	/* scheduler ticks */
+	uint32_t ctx_switches;	/* switches from one process to another */
+	uint32_t sched_demotions;	/* processes moved down for using their quantum */
+	uint32_t sched_wakeups;	/* blocked processes woken (and moved up) */
+	uint32_t sched_boosts;	/* times every process was put back on top */
+	uint32_t echo_lines;	/* lines a waiting terminal read got */
+	uint32_t echo_cycles;	/* ...cycles from enter to the reader running */
+	uint32_t echo_max;	/* ...the longest of those (not a counter) */
+	uint32_t timer_irqs;	/* PIT interrupts, fewer than ticks while idle */
+	uint32_t timer_oneshots;	/* ...that armed a one-shot instead of ticking */
+	uint32_t rtc_irqs;	/* RTC interrupts, none while nobody has it open */
+	uint32_t ktimers_fired;	/* kernel timers that ran their callback */
+	uint32_t ktimer_cascades;	/* ...moves of a timer down a level of the wheel */
+	uint32_t cpus;			/* processors online */
+	uint32_t sched_steals;		/* processes an idle processor took from another one's queue */
+	uint32_t kernel_lock_waits;	/* kernel entries that had to wait for another processor */
+} __attribute__((packed)) ece391_kstats_t;
+
+extern int32_t ece391_kstat (ece391_kstats_t* buf, int32_t nbytes);
+
+/*
+ * How long the kernel kept interrupts disabled.  hist[0] counts windows
+ * shorter than 2^IRQOFF_SHIFT cycles, hist[i] those shorter than
+ * 2^(IRQOFF_SHIFT+i), and the last bucket everything longer.  sites
+ * holds the source lines that kept them off the longest (unused ones
+ * have cycles 0).  irqoff copies at most sizeof (ece391_irqoff_t) bytes.
+ */
+#define IRQOFF_BUCKETS 16
+#define IRQOFF_SHIFT 11
+#define IRQOFF_SITES 8
+#define IRQOFF_FILE 16
+
+typedef struct ece391_irqoff_site {
+	uint32_t cycles;	/* longest window opened here */
+	uint32_t line;
+	int8_t file[IRQOFF_FILE];
+} __attribute__((packed)) ece391_irqoff_site_t;
+
+typedef struct ece391_irqoff {
+	uint32_t windows;	/* times interrupts were turned off */
+	uint32_t max;		/* longest window in cycles */
+	uint32_t hist[IRQOFF_BUCKETS];
+	ece391_irqoff_site_t sites[IRQOFF_SITES];
+} __attribute__((packed)) ece391_irqoff_t;
+
+extern int32_t ece391_irqoff (ece391_irqoff_t* buf, int32_t nbytes);
+
+/*
+ * clock_gettime fills ts with the time since boot (CLOCK_MONOTONIC is
+ * the only clock).  The kernel also publishes its clock on a read-only
+ * page mapped into every program at ECE391_TIME_PAGE; ece391_clock in
+ * ece391support.c reads it without a system call whenever the kernel's
+ * clock runs on the TSC (tsc_valid), retrying while seq is odd or
+ * changes under it.
+ */
+#define CLOCK_MONOTONIC 0
+
+typedef struct ece391_timespec {
+	uint32_t sec;
+	uint32_t nsec;
+} __attribute__((packed)) ece391_timespec_t;
+
+typedef struct ece391_time_page {
+	uint32_t seq;		/* odd while the kernel updates it */
+	uint32_t tsc_valid;	/* 1 if the clock can be read from the TSC */
+	uint32_t tsc_hz;	/* calibrated TSC rate */
+	uint32_t mult;		/* ns = (tsc cycles * mult) >> shift */
+	uint32_t shift;
+	uint64_t tsc_last;	/* TSC when sec and nsec were taken */
+	uint32_t sec;
+	uint32_t nsec;
+} __attribute__((packed)) ece391_time_page_t;
+
+#define ECE391_TIME_PAGE ((volatile ece391_time_page_t*)0x084C0000)
+
+extern int32_t ece391_clock_gettime (int32_t clock, ece391_timespec_t* ts);
+
+/*
+ * nanosleep blocks for at least req (nsec below 1000000000), rounded up
+ * to the kernel's 10ms tick; sleep does the same for whole seconds.  The
+ * program doesn't run at all in the meantime.
+ */
+extern int32_t ece391_nanosleep (const ece391_timespec_t* req);
+extern int32_t ece391_sleep (uint32_t seconds);
+
+/*
+ * irqstat fills st with the interrupts of each vector a kernel driver
+ * registered, nvec of them in registration order: how many came in and
+ * a histogram of the cycles from entering the kernel to the EOI.  Bucket
+ * 0 counts those under 2^IRQ_LAT_SHIFT cycles, bucket i those under
+ * 2^(IRQ_LAT_SHIFT+i), and the last bucket everything longer.  irqstat
+ * copies at most sizeof (ece391_irqstat_t) bytes.
+ */
+#define IRQ_SLOTS 16
+#define IRQ_LAT_BUCKETS 16
+#define IRQ_LAT_SHIFT 8
+#define IRQ_NAME 12
+
+typedef struct ece391_irq_vec {
+	uint32_t vector;
+	uint32_t count;		/* interrupts taken */
+	uint32_t eois;		/* ...that reached their EOI, the ones in hist */
+	uint32_t max;		/* longest entry to EOI in cycles */
+	uint32_t hist[IRQ_LAT_BUCKETS];
+	int8_t name[IRQ_NAME];
+} __attribute__((packed)) ece391_irq_vec_t;
+
+typedef struct ece391_irqstat {
+	uint32_t nvec;
+	ece391_irq_vec_t vec[IRQ_SLOTS];
+} __attribute__((packed)) ece391_irqstat_t;
+
+extern int32_t ece391_irqstat (ece391_irqstat_t* buf, int32_t nbytes);
 
 enum signums {
 	DIV_ZERO = 0,
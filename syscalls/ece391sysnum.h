@@ -11,5 +11,20 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_GETDENTS  11
+#define SYS_STAT  12
+#define SYS_FSTAT  13
+#define SYS_LSEEK  14
+#define SYS_PREAD  15
+#define SYS_MMAP  16
+#define SYS_KSTAT  17
+#define SYS_SBRK  18
+#define SYS_IRQOFF  19
+#define SYS_NICE  20
+#define SYS_CLOCK_GETTIME  21
+#define SYS_NANOSLEEP  22
+#define SYS_SLEEP  23
+#define SYS_IRQSTAT  24
+#define SYS_MUNMAP  25
 
 #endif /* ECE391SYSNUM_H */
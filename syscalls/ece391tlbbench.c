@@ -0,0 +1,69 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define NBUFSIZE 12
+#define LAUNCHES 20
+
+static void
+put_stat (const char* name, uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* low 32 bits of the time stamp counter */
+static uint32_t
+cycles (void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
+
+/*
+ * Runs a program (testprint unless one is given) several times.  Every
+ * launch switches to the child's address space and back, so the average
+ * round trip shows what those switches cost, and the counters show how
+ * many TLB flushes each one took.
+ */
+int main ()
+{
+    uint8_t cmd[BUFSIZE];
+    ece391_kstats_t before, after;
+    uint32_t i, start, total = 0;
+
+    if (0 != ece391_getargs (cmd, BUFSIZE) || '\0' == cmd[0])
+        ece391_strcpy (cmd, (uint8_t*)"testprint");
+
+    /* once so the image is cached and not part of the measurement */
+    if (-1 == ece391_execute (cmd)) {
+        ece391_fdputs (1, (uint8_t*)"execute failed\n");
+        return 3;
+    }
+
+    if (sizeof (before) != ece391_kstat (&before, sizeof (before))) {
+        ece391_fdputs (1, (uint8_t*)"kstat failed\n");
+        return 3;
+    }
+    for (i = 0; i < LAUNCHES; i++) {
+        start = cycles ();
+        ece391_execute (cmd);
+        total += cycles () - start;
+    }
+    ece391_kstat (&after, sizeof (after));
+
+    put_stat ("launches: ", LAUNCHES);
+    put_stat ("average cycles per launch: ", total / LAUNCHES);
+    put_stat ("TLB flushes per launch: ",
+              (after.tlb_flushes - before.tlb_flushes) / LAUNCHES);
+    put_stat ("single-page invalidations: ", after.tlb_pages - before.tlb_pages);
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NBUFSIZE 12
+#define NUM_COLS 80
+#define NUM_ROWS 25
+#define ATTRIB 0x7
+#define REDRAWS 100
+#define LINES 50
+
+static void
+put_stat (const char* name, uint32_t value)
+{
+    uint8_t num[NBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (value, num, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+/* low 32 bits of the time stamp counter */
+static uint32_t
+cycles (void)
+{
+    uint32_t lo, hi;
+
+    asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+    return lo;
+}
+
+/*
+ * Times full-screen redraws through vidmap, the way fish draws its
+ * frames, then prints enough lines to make the terminal scroll and
+ * reports what the kernel spent on each scroll.
+ */
+int main ()
+{
+    uint8_t* screen;
+    ece391_kstats_t before, after;
+    uint32_t i, j, start, total;
+
+    if (-1 == ece391_vidmap (&screen)) {
+        ece391_fdputs (1, (uint8_t*)"vidmap failed\n");
+        return 3;
+    }
+
+    start = cycles ();
+    for (i = 0; i < REDRAWS; i++) {
+        for (j = 0; j < NUM_ROWS * NUM_COLS; j++) {
+            screen[j << 1] = 'A' + (i + j) % 26;
+            screen[(j << 1) + 1] = ATTRIB;
+        }
+    }
+    total = cycles () - start;
+
+    if (sizeof (before) != ece391_kstat (&before, sizeof (before))) {
+        ece391_fdputs (1, (uint8_t*)"kstat failed\n");
+        return 3;
+    }
+    for (i = 0; i < LINES; i++)
+        ece391_fdputs (1, (uint8_t*)"scroll\n");
+    ece391_kstat (&after, sizeof (after));
+
+    put_stat ("average cycles per redraw: ", total / REDRAWS);
+    put_stat ("scrolls: ", after.scrolls - before.scrolls);
+    if (after.scrolls != before.scrolls)
+        put_stat ("average cycles per scroll: ", (after.scroll_cycles - before.scroll_cycles)
+                  / (after.scrolls - before.scrolls));
+
+    return 0;
+}